@@ -1,10 +1,14 @@
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <limits>
 #include <iostream>
-#include <map>
+#include <optional>
 #include <regex>
 #include <set>
+#include <string>
+#include <thread>
 #include <vector>
 
 static constexpr std::size_t dims = 3;
@@ -49,242 +53,444 @@ auto distance(pos_t const & a, pos_t const & b) -> std::size_t
     return ret;
 }
 
-// Rotate a position vector one of 24 different ways
-// Model cube looking down from top.
-// x is left to right
-// y is bottom to top
-// z is down to up
-auto rotate(pos_t a, int face, int rotate) -> pos_t
+static constexpr int orientations = 24;
+
+// A rotation as a permutation and sign for each axis: axis i of the result is sign[i] * a[axis[i]]
+struct rotation_t
 {
-    auto which_face = face % 6;
-    // Rotate which face is towards us
-    switch(which_face)
-    {
-        case 1: // Take up and point it towards us; y -> z, +z -> -y
-            std::swap(a[1], a[2]);
-            a[1] *= -1;
-            break; 
-        case 2: // Take right and point it towards us; x -> z, +z -> -x
-            std::swap(a[0], a[2]);
-            a[0] *= -1;
-            break;
-        case 3: // Take down and point it towards us; -y -> +z, z -> y
-            std::swap(a[1], a[2]);
-            a[2] *= -1;
-            break;
-        case 4: // Take left and point it towards us; -x -> +z, z -> x
-            std::swap(a[0], a[2]);
-            a[2] *= -1;
-            break;
-        case 5: // Take back and point it towards us, rotating along x axix; -y -> +y, -z -> +z
-            a[1] *= -1;
-            a[2] *= -1;
-            break;
-        default: // Nothing to do here
-            break;
-    }
+    std::array<int, dims> axis;
+    std::array<int, dims> sign;
+};
 
-    auto which_rotate = rotate % 4;
-  
-    // Now rotate the face that points towards us, clockwise along the z axis
-    for(int i = 0; i < which_rotate; ++i)
+// The 24 ways a scanner can face, with no rotation first. Even permutations of the axes
+// keep an even number of negations, and odd permutations an odd number.
+static constexpr std::array<rotation_t, orientations> rotations{{
+    {{0,1,2}, {+1,+1,+1}}, {{0,1,2}, {+1,-1,-1}}, {{0,1,2}, {-1,+1,-1}}, {{0,1,2}, {-1,-1,+1}},
+    {{1,2,0}, {+1,+1,+1}}, {{1,2,0}, {+1,-1,-1}}, {{1,2,0}, {-1,+1,-1}}, {{1,2,0}, {-1,-1,+1}},
+    {{2,0,1}, {+1,+1,+1}}, {{2,0,1}, {+1,-1,-1}}, {{2,0,1}, {-1,+1,-1}}, {{2,0,1}, {-1,-1,+1}},
+    {{0,2,1}, {-1,-1,-1}}, {{0,2,1}, {-1,+1,+1}}, {{0,2,1}, {+1,-1,+1}}, {{0,2,1}, {+1,+1,-1}},
+    {{1,0,2}, {-1,-1,-1}}, {{1,0,2}, {-1,+1,+1}}, {{1,0,2}, {+1,-1,+1}}, {{1,0,2}, {+1,+1,-1}},
+    {{2,1,0}, {-1,-1,-1}}, {{2,1,0}, {-1,+1,+1}}, {{2,1,0}, {+1,-1,+1}}, {{2,1,0}, {+1,+1,-1}},
+}};
+
+// Every entry must be a proper rotation (a signed permutation with determinant +1), and no two the same
+constexpr auto valid_rotations() -> bool
+{
+    for(int r = 0; r < orientations; ++r)
     {
-        // +y -> -x, x -> y
-        std::swap(a[0], a[1]);
-        a[0] *= -1;
+        auto & rotation = rotations[r];
+        int determinant = 1;
+
+        for(std::size_t i = 0; i < dims; ++i)
+        {
+            if(rotation.sign[i] != 1 && rotation.sign[i] != -1)
+                return false;
+            determinant *= rotation.sign[i];
+
+            for(std::size_t j = i + 1; j < dims; ++j)
+            {
+                if(rotation.axis[i] == rotation.axis[j])
+                    return false;
+                if(rotation.axis[i] > rotation.axis[j])
+                    determinant = -determinant;
+            }
+        }
+
+        if(determinant != 1)
+            return false;
+
+        for(int other = 0; other < r; ++other)
+        {
+            if(rotations[other].axis == rotation.axis && rotations[other].sign == rotation.sign)
+                return false;
+        }
     }
-    return a;
+
+    return true;
 }
 
-class scanner_t
+static_assert(valid_rotations(), "Rotation table must hold exactly the 24 distinct proper rotations");
+
+auto orient(pos_t const & a, int orientation) -> pos_t
+{
+    auto & rotation = rotations[orientation];
+    pos_t ret;
+    for(std::size_t i = 0; i < dims; ++i)
+        ret[i] = rotation.sign[i] * a[rotation.axis[i]];
+    return ret;
+}
+
+// Every orientation of a set of beacons, held as separate x, y and z arrays. Each copy is a
+// plain scaled copy of one input column, which the compiler turns into packed SIMD negations.
+class oriented_beacons_t
 {
 public:
-    explicit scanner_t(pos_set_t const & pos);
-    // Try and combine with another scanner
-    auto combine(scanner_t const & other) -> bool;
+    explicit oriented_beacons_t(std::vector<pos_t> const & beacons)
+    : m_size{beacons.size()}
+    , m_coords(orientations * dims * beacons.size())
+    {
+        // Transpose to one column per axis first
+        std::vector<std::int32_t> columns(dims * m_size);
+        for(std::size_t i = 0; i < m_size; ++i)
+            for(std::size_t axis = 0; axis < dims; ++axis)
+                columns[axis * m_size + i] = beacons[i][axis];
+
+        for(int orientation = 0; orientation < orientations; ++orientation)
+        {
+            for(std::size_t axis = 0; axis < dims; ++axis)
+            {
+                auto sign = rotations[orientation].sign[axis];
+                auto const * from = columns.data() + rotations[orientation].axis[axis] * m_size;
+                auto * to = m_coords.data() + (orientation * dims + axis) * m_size;
+
+                for(std::size_t i = 0; i < m_size; ++i)
+                    to[i] = sign * from[i];
+            }
+        }
+    }
+
+    auto size() const -> std::size_t
+    {
+        return m_size;
+    }
+
+    // One axis of every beacon in the given orientation
+    auto column(int orientation, int axis) const -> std::int32_t const *
+    {
+        return m_coords.data() + (orientation * dims + axis) * m_size;
+    }
 
-    auto size() const -> std::size_t;
-    auto range() const -> std::size_t;
 private:
-    scanner_t() = default;
-    auto rot(int face, int rot) const -> scanner_t;
-
-    auto shiftcombine(scanner_t const & rotated, std::map<pos_t, std::pair<pos_t, pos_t>> const & intersect) -> bool;
-
-    //using index_pair = std::pair<std::size_t, std::size_t>;
-    //using difference_set = std::set<pos_t>;
-    using difference_mapping = std::map<pos_t, pos_t>;
-    //auto differences(int rot) -> difference_set;
-    // Get the differences between each pair
-    auto differences() const -> difference_mapping;
-    // Get the intersection of differences, mapping them to mine and theirs
-    static auto intersection(difference_mapping const & mine, difference_mapping const & theirs) -> std::map<pos_t, std::pair<pos_t, pos_t>>;
-    // Get the manhattan distances between each pair
-    //auto distances() const -> std::set<int>;
-    
-    pos_set_t m_beacons;
-    pos_set_t m_scanners;
+    std::size_t m_size;
+    std::vector<std::int32_t> m_coords;
 };
 
-scanner_t::scanner_t(pos_set_t const & pos)
-: m_beacons{pos}
-{}
-
-auto scanner_t::size() const -> std::size_t
+auto operator-(pos_t const & a) -> pos_t
 {
-    return m_beacons.size();
+    return zero - a;
 }
 
-auto scanner_t::range() const -> std::size_t
+auto squared_length(pos_t const & a) -> std::int64_t
 {
-    std::size_t ret = 0;
+    std::int64_t ret = 0;
+    for(std::size_t i = 0; i < dims; ++i)
+        ret += static_cast<std::int64_t>(a[i]) * a[i];
+    return ret;
+}
 
-    std::for_each(m_scanners.begin(), m_scanners.end(), [this, &ret](auto first)
+// Orientation followed by a shift, taking positions in one scanner's frame into another's
+struct transform_t
+{
+    static auto oriented(int orientation, pos_t shift = zero) -> transform_t
     {
-        std::for_each(m_scanners.begin(), m_scanners.end(), [first, &ret](auto second)
+        transform_t ret{{}, shift};
+        for(std::size_t i = 0; i < dims; ++i)
         {
-            auto dist = distance(first, second);
-            std::cout << "Measured distance of " << dist << " from ";
-            print(first);
-            std::cout << " to ";
-            print(second);
-            std::cout << std::endl;
-            if(dist > ret)
-            {
-                ret = dist;
-            }
-        });
-    });
+            pos_t unit{zero};
+            unit[i] = 1;
+            ret.axes[i] = orient(unit, orientation);
+        }
+        return ret;
+    }
 
-    return ret;
-}
+    auto rotate(pos_t const & a) const -> pos_t
+    {
+        pos_t ret{zero};
+        for(std::size_t i = 0; i < dims; ++i)
+            for(std::size_t j = 0; j < dims; ++j)
+                ret[j] += a[i] * axes[i][j];
+        return ret;
+    }
 
-auto scanner_t::rot(int face, int rot) const -> scanner_t
-{
-    scanner_t ret{};
+    auto operator()(pos_t const & a) const -> pos_t
+    {
+        return rotate(a) + shift;
+    }
 
-    std::for_each(m_beacons.begin(), m_beacons.end(), [face, rot, &ret](auto beacon)
+    // This transform, followed by outer
+    auto then(transform_t const & outer) const -> transform_t
     {
-        ret.m_beacons.insert(rotate(beacon, face, rot));
-    });
+        transform_t ret{{}, outer(shift)};
+        for(std::size_t i = 0; i < dims; ++i)
+            ret.axes[i] = outer.rotate(axes[i]);
+        return ret;
+    }
 
-    std::for_each(m_scanners.begin(), m_scanners.end(), [face, rot, &ret](auto scanner)
+    // Rotations are orthogonal, so the inverse rotation is the transpose
+    auto inverse() const -> transform_t
     {
-        ret.m_scanners.insert(rotate(scanner, face, rot));
-    });
+        transform_t ret{};
+        for(std::size_t i = 0; i < dims; ++i)
+            for(std::size_t j = 0; j < dims; ++j)
+                ret.axes[i][j] = axes[j][i];
+        ret.shift = -ret.rotate(shift);
+        return ret;
+    }
 
-    return ret;
-}
+    std::array<pos_t, dims> axes; // Where each unit axis ends up
+    pos_t shift;
+};
+
+static const transform_t identity{transform_t::oriented(0)};
 
-auto scanner_t::shiftcombine(scanner_t const & rotated, std::map<pos_t, std::pair<pos_t, pos_t>> const & intersect) -> bool
+// Flat open-addressing tally of how many beacon pairs agree on each shift. The slots are
+// allocated once and cleared between orientations, so voting never allocates.
+class shift_votes_t
 {
+public:
+    explicit shift_votes_t(std::size_t votes)
+    {
+        std::size_t capacity = 16;
+        while(capacity < 2 * votes)
+            capacity *= 2;
+        m_slots.resize(capacity);
+        clear();
+    }
 
-    // A = B - C
-    // C = B - A
-    auto first = intersect.begin();
-    if(first == intersect.end())
+    void clear()
     {
-        std::cout << "Intersection size is zero\n";
-        throw 5;
+        std::fill(m_slots.begin(), m_slots.end(), slot_t{empty, 0});
     }
 
-    auto shift = first->second.first - first->second.second;
+    // Count one more vote for this shift, returning its total so far
+    auto vote(pos_t const & shift) -> std::size_t
+    {
+        auto key = pack(shift);
+        auto mask = m_slots.size() - 1;
+        auto slot = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
 
-    std::for_each(rotated.m_beacons.begin(), rotated.m_beacons.end(), [this, shift](auto pos)
+        while(m_slots[slot].key != empty && m_slots[slot].key != key)
+            slot = (slot + 1) & mask;
+
+        m_slots[slot].key = key;
+        return ++m_slots[slot].count;
+    }
+
+private:
+    struct slot_t
     {
-        auto shifted = pos + shift;
-        m_beacons.insert(shifted);
-    });
+        std::uint64_t key;
+        std::uint32_t count;
+    };
+
+    static constexpr std::uint64_t empty = ~std::uint64_t{0};
+    static constexpr int bits = 21;
+    static constexpr int bias = 1 << (bits - 1);
 
-    // Remember where the scanner was
-    m_scanners.insert(zero + shift);
-    
-    // And any other scanners it knew about
-    std::for_each(rotated.m_scanners.begin(), rotated.m_scanners.end(), [this, shift](auto pos)
+    static auto pack(pos_t const & shift) -> std::uint64_t
     {
-        auto shifted = pos + shift;
-        m_scanners.insert(shifted);
-    });
+        std::uint64_t key = 0;
+        for(std::size_t i = 0; i < dims; ++i)
+        {
+            if(shift[i] < -bias || shift[i] >= bias)
+            {
+                std::cout << "Shift too large to count: ";
+                print(shift);
+                std::cout << std::endl;
+                throw 5;
+            }
+            key = (key << bits) | static_cast<std::uint64_t>(shift[i] + bias);
+        }
+        return key;
+    }
 
-    return true;
-}
+    std::vector<slot_t> m_slots;
+};
+
+// The outcome of trying to line another scanner's beacons up with mine
+struct alignment_t
+{
+    auto found() const -> bool
+    {
+        return matched >= overlapping_beacons;
+    }
 
-auto scanner_t::combine(scanner_t const & other) -> bool
+    auto transform() const -> transform_t
+    {
+        return transform_t::oriented(orientation, shift);
+    }
+
+    std::size_t shared = 0;     // Pair distances in common
+    std::size_t matched = 0;    // Beacons lined up by the best orientation and shift tried
+    int orientation = 0;
+    pos_t shift = zero;
+};
+
+class scanner_t
 {
-    std::cout << "Combining scanners\n";
-    for(int f = 0; f < 6; ++f)
+public:
+    explicit scanner_t(pos_set_t const & pos);
+    // Find how to take the other scanner's beacons into my frame
+    auto align(scanner_t const & other) const -> alignment_t;
+
+    auto beacons() const -> std::vector<pos_t> const &;
+private:
+    // Squared distance between a pair of beacons, which is the same whichever way the scanner faces
+    struct pair_distance_t
     {
-        for(int r = 0; r < 4; ++r)
+        auto operator<(pair_distance_t const & rhs) const -> bool
         {
-            auto rotated = other.rot(f, r);
-            std::cout << "Trying face " << f << ", rotation " << r << "\n";
+            return squared < rhs.squared;
+        }
 
-            auto mine = differences();
-            auto theirs = rotated.differences();
+        std::int64_t squared;
+        std::uint32_t first;
+        std::uint32_t second;
+    };
 
-            auto intersect = intersection(mine, theirs);
+    // Every pair distance, sorted, along with the beacons they index into
+    struct fingerprint_t
+    {
+        std::vector<pos_t> beacons;
+        std::vector<pair_distance_t> distances;
+    };
 
-            if(intersect.size() >= overlapping_distances)
-            {
-                std::cout << "Found " << intersect.size() << " intersections\n";
-                shiftcombine(rotated, intersect);
-                std::cout << "Combination complete, now have " << size() << "\n";
-                return true;
-            }
+    auto fingerprint() const -> fingerprint_t;
+    // Count the distances the two have in common
+    static auto shared_distances(fingerprint_t const & mine, fingerprint_t const & theirs) -> std::size_t;
+    // Find the shift most beacons agree on for the other scanner in this orientation, stopping
+    // as soon as enough agree
+    auto vote(scanner_t const & other, int orientation, shift_votes_t & votes, alignment_t & best) const -> void;
+
+    pos_set_t m_beacons;
+    fingerprint_t m_fingerprint;
+    oriented_beacons_t m_oriented;
+};
+
+scanner_t::scanner_t(pos_set_t const & pos)
+: m_beacons{pos}
+, m_fingerprint{fingerprint()}
+, m_oriented{m_fingerprint.beacons}
+{}
+
+auto scanner_t::beacons() const -> std::vector<pos_t> const &
+{
+    return m_fingerprint.beacons;
+}
+
+auto scanner_t::fingerprint() const -> fingerprint_t
+{
+    fingerprint_t ret{std::vector<pos_t>(m_beacons.begin(), m_beacons.end()), {}};
+    auto & beacons = ret.beacons;
+
+    ret.distances.reserve(beacons.size() * (beacons.size() - 1) / 2);
+
+    for(std::uint32_t first = 0; first < beacons.size(); ++first)
+    {
+        for(std::uint32_t second = first + 1; second < beacons.size(); ++second)
+        {
+            ret.distances.push_back(pair_distance_t{squared_length(beacons[first] - beacons[second]), first, second});
         }
     }
-    return false;
+
+    std::sort(ret.distances.begin(), ret.distances.end());
+
+    return ret;
 }
 
-auto scanner_t::intersection(difference_mapping const & mine, difference_mapping const & theirs) -> std::map<pos_t, std::pair<pos_t, pos_t>>
+auto scanner_t::shared_distances(fingerprint_t const & mine, fingerprint_t const & theirs) -> std::size_t
 {
-    std::map<pos_t, std::pair<pos_t, pos_t>> ret;
+    std::size_t ret = 0;
+    auto lhs = mine.distances.begin();
+    auto rhs = theirs.distances.begin();
 
-    std::for_each(mine.begin(), mine.end(), [theirs, &ret](auto lhs)
+    while(lhs != mine.distances.end() && rhs != theirs.distances.end())
     {
-        auto found = theirs.find(lhs.first);
-        if(found != theirs.end())
+        if(*lhs < *rhs)
+            ++lhs;
+        else if(*rhs < *lhs)
+            ++rhs;
+        else
         {
-            ret[lhs.first] = std::make_pair(lhs.second, found->second);
+            ++ret;
+            ++lhs;
+            ++rhs;
         }
-    });
+    }
 
     return ret;
 }
 
-/*auto scanner_t::differences(int rot) -> difference_set
+auto scanner_t::vote(scanner_t const & other, int orientation, shift_votes_t & votes, alignment_t & best) const -> void
 {
-    auto rotated = m_beacons;
-    std::for_each(rotated.begin(), rotated.end(), [](auto & pos){pos = rotate(pos, rot)});
+    auto & theirs = other.m_oriented;
+    auto xs = theirs.column(orientation, 0);
+    auto ys = theirs.column(orientation, 1);
+    auto zs = theirs.column(orientation, 2);
 
-    for(std::size_t first = 0; first < size(); ++first)
+    votes.clear();
+
+    for(auto const & beacon : m_fingerprint.beacons)
     {
-        for(std::size_t second = 0; second < size(); ++second)
+        for(std::size_t i = 0; i < theirs.size(); ++i)
         {
-            if(first != second)
+            pos_t shift{beacon[0] - xs[i], beacon[1] - ys[i], beacon[2] - zs[i]};
+            auto count = votes.vote(shift);
+
+            if(count > best.matched)
             {
-                auto diff = m_beacons[first] - m_beacons[second];
-                ret[diff] = std::make_pair(first, second);
+                best.matched = count;
+                best.orientation = orientation;
+                best.shift = shift;
+
+                if(best.found())
+                    return;
             }
         }
     }
-}*/
+}
 
-auto scanner_t::differences() const -> difference_mapping
+auto scanner_t::align(scanner_t const & other) const -> alignment_t
 {
-    difference_mapping ret;
-
-    std::for_each(m_beacons.begin(), m_beacons.end(), [this, &ret](auto first)
+    auto & mine = m_fingerprint;
+    auto & theirs = other.m_fingerprint;
+    alignment_t ret{shared_distances(mine, theirs)};
+
+    // Scanners that overlap by enough beacons must share at least as many pair distances
+    if(ret.shared < overlapping_distances)
+        return ret;
+
+    // Any pair of beacons with the same distance in both is likely the same pair, and the
+    // orientation which lines up their difference vectors is a candidate for the whole scanner
+    std::array<bool, orientations> tried{};
+    shift_votes_t votes{mine.beacons.size() * theirs.beacons.size()};
+    auto lhs = mine.distances.begin();
+    auto rhs = theirs.distances.begin();
+
+    while(lhs != mine.distances.end() && rhs != theirs.distances.end())
     {
-        std::for_each(m_beacons.begin(), m_beacons.end(), [first, &ret](auto second)
+        if(*lhs < *rhs)
         {
-            if(first != second)
-            {
-                auto diff = first - second;
-                ret[diff] = first;
-            }
-        });
-    });
+            ++lhs;
+            continue;
+        }
+        if(*rhs < *lhs)
+        {
+            ++rhs;
+            continue;
+        }
+
+        auto a_diff = mine.beacons[lhs->first] - mine.beacons[lhs->second];
+        auto b_diff = theirs.beacons[rhs->first] - theirs.beacons[rhs->second];
+
+        for(int orientation = 0; orientation < orientations; ++orientation)
+        {
+            auto oriented = orient(b_diff, orientation);
+
+            // Either way round counts, as we don't know which end is which
+            if(tried[orientation] || (oriented != a_diff && oriented != -a_diff))
+                continue;
+
+            tried[orientation] = true;
+            vote(other, orientation, votes, ret);
+
+            if(ret.found())
+                return ret;
+        }
+
+        ++lhs;
+        ++rhs;
+    }
 
     return ret;
 }
@@ -338,15 +544,15 @@ auto get_scanner() -> std::pair<int, scanner_t>
     return std::make_pair(id, scanner_t{positions});
 }
 
-auto get_scanners() -> std::map<int, scanner_t>
+auto get_scanners() -> std::vector<scanner_t>
 {
-    std::map<int, scanner_t> scanners;
+    std::vector<scanner_t> scanners;
 
     while(true)
     {
         try
         {
-            scanners.insert(get_scanner());
+            scanners.push_back(get_scanner().second);
         }
         catch(...)
         {
@@ -356,47 +562,148 @@ auto get_scanners() -> std::map<int, scanner_t>
     return scanners;
 }
 
-// Combine all the scanners together
-auto combine(std::map<int, scanner_t> scanners) -> scanner_t
+// An overlap found between a pair of scanners, taking second's beacons into first's frame
+struct overlap_t
+{
+    std::size_t first;
+    std::size_t second;
+    transform_t transform;
+};
+
+// Try every pair of scanners on a pool of threads. Each thread claims the next pair with
+// an atomic counter and is the only writer of that pair's slot in the results, so no locks
+// are needed, and the results are only read once every thread has been joined.
+auto overlaps(std::vector<scanner_t> const & scanners, std::size_t threads, bool verbose) -> std::vector<overlap_t>
+{
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    for(std::size_t first = 0; first < scanners.size(); ++first)
+        for(std::size_t second = first + 1; second < scanners.size(); ++second)
+            pairs.emplace_back(first, second);
+
+    std::vector<alignment_t> results(pairs.size());
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
+
+    for(std::size_t t = 0; t < std::max<std::size_t>(threads, 1); ++t)
+    {
+        workers.emplace_back([&scanners, &pairs, &results, &next]
+        {
+            for(auto i = next++; i < pairs.size(); i = next++)
+                results[i] = scanners[pairs[i].first].align(scanners[pairs[i].second]);
+        });
+    }
+
+    std::for_each(workers.begin(), workers.end(), [](auto & worker){ worker.join(); });
+
+    std::vector<overlap_t> ret;
+    for(std::size_t i = 0; i < pairs.size(); ++i)
+    {
+        auto & [first, second] = pairs[i];
+        auto & result = results[i];
+
+        if(verbose && result.shared > 0)
+        {
+            std::cout << "Scanners " << first << " and " << second << " share " << result.shared << " distances, lined up "
+                      << result.matched << " beacons with orientation " << result.orientation << " and shift ";
+            print(result.shift);
+            std::cout << std::endl;
+        }
+
+        if(result.found())
+            ret.push_back(overlap_t{first, second, result.transform()});
+    }
+
+    if(verbose)
+        std::cout << "Found " << ret.size() << " overlaps among " << pairs.size() << " pairs of scanners" << std::endl;
+
+    return ret;
+}
+
+// Work out how to take each scanner's beacons into the frame of the first scanner, by
+// walking outwards from it over the overlap graph
+auto locate(std::size_t count, std::vector<overlap_t> const & found) -> std::vector<transform_t>
 {
-    while(scanners.size() > 1)
+    std::vector<std::vector<std::pair<std::size_t, transform_t>>> graph(count);
+    std::for_each(found.begin(), found.end(), [&graph](auto const & overlap)
     {
-        bool have_combined = false;
-        for(auto dest = scanners.begin(); dest != scanners.end(); ++dest)
+        graph[overlap.first].emplace_back(overlap.second, overlap.transform);
+        graph[overlap.second].emplace_back(overlap.first, overlap.transform.inverse());
+    });
+
+    std::vector<std::optional<transform_t>> located(count);
+    std::vector<std::size_t> queue{0};
+    located[0] = identity;
+
+    for(std::size_t head = 0; head < queue.size(); ++head)
+    {
+        auto from = queue[head];
+
+        for(auto const & [to, transform] : graph[from])
         {
-            auto next = dest;
-            std::advance(next, 1);
-            for(auto source = next; source != scanners.end(); ++source)
+            if(!located[to])
             {
-                if(dest->second.combine(source->second))
-                {
-                    std::cout << "Erasing\n";
-                    scanners.erase(source->first);
-                    next = dest;
-                    have_combined = true;
-                    break;
-                }
+                located[to] = transform.then(*located[from]);
+                queue.push_back(to);
             }
         }
+    }
 
-        if(!have_combined)
-        {
-            std::cout << "Didn't find any scanners to combine, still have " << scanners.size() << " remaining" << std::endl;
-            throw 5;
-        }
+    if(queue.size() != count)
+    {
+        std::cout << "Could only locate " << queue.size() << " of " << count << " scanners" << std::endl;
+        throw 5;
     }
 
-    return scanners.begin()->second;
+    std::vector<transform_t> ret;
+    std::for_each(located.begin(), located.end(), [&ret](auto const & transform){ ret.push_back(*transform); });
+    return ret;
+}
+
+// Every beacon, in the frame of the first scanner, without duplicates
+auto combine(std::vector<scanner_t> const & scanners, std::vector<transform_t> const & located) -> std::vector<pos_t>
+{
+    std::vector<pos_t> ret;
+
+    for(std::size_t i = 0; i < scanners.size(); ++i)
+    {
+        auto & beacons = scanners[i].beacons();
+        std::transform(beacons.begin(), beacons.end(), std::back_inserter(ret), located[i]);
+    }
+
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+
+    return ret;
+}
+
+// Largest manhattan distance between any pair of scanners
+auto range(std::vector<transform_t> const & located) -> std::size_t
+{
+    std::size_t ret = 0;
+
+    std::for_each(located.begin(), located.end(), [&located, &ret](auto const & first)
+    {
+        std::for_each(located.begin(), located.end(), [&first, &ret](auto const & second)
+        {
+            ret = std::max(ret, distance(first.shift, second.shift));
+        });
+    });
+
+    return ret;
 }
 
-int main()
+// Usage: main [threads] [verbose]
+int main(int argc, char * argv[])
 {
+    std::size_t threads = argc > 1 ? std::stoul(argv[1]) : std::thread::hardware_concurrency();
+    bool verbose = argc > 2 && std::string{argv[2]} == "verbose";
+
     auto scanners = get_scanners();
 
-    auto combined = combine(scanners);
+    auto located = locate(scanners.size(), overlaps(scanners, threads, verbose));
 
-    std::cout << combined.size() << std::endl;
-    std::cout << combined.range() << std::endl;
+    std::cout << combine(scanners, located).size() << std::endl;
+    std::cout << range(located) << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,9 +1,19 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <compare>
+#include <cstdint>
 #include <iostream>
 #include <list>
+#include <numeric>
 #include <optional>
-#include <regex>
-#include <set>
+#include <random>
+#include <ranges>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 using pair = std::pair<std::string, std::string>;
 
@@ -24,10 +34,26 @@ auto parse() -> std::list<pair>
     return ret;
 }
 
+// Parse an integer from the front of the text, which is left pointing past it
+auto parse_value(std::string_view & in) -> int
+{
+    int value = 0;
+    auto [end, ec] = std::from_chars(in.data(), in.data() + in.size(), value);
+
+    if(ec != std::errc{})
+    {
+        std::cout << "Failed to parse " << in << std::endl;
+        throw 0;
+    }
+
+    in.remove_prefix(static_cast<std::size_t>(end - in.data()));
+    return value;
+}
+
 class packet_t
 {
 public:
-    explicit packet_t(std::string & in);
+    explicit packet_t(std::string_view & in);
     auto operator<(packet_t const & rhs) const -> bool;
     auto print() const -> std::string;
 private:
@@ -35,50 +61,38 @@ private:
     std::list<packet_t> m_list;
 };
 
-// Construct a packet from a string. This consumes the string in parsed chunks
-packet_t::packet_t(std::string & in)
+// Construct a packet from the front of the text, which is left pointing past it
+packet_t::packet_t(std::string_view & in)
 : m_value{std::nullopt}, m_list{}
 {
-    std::regex regex("^(-?[0-9]+)");
-    std::smatch match;
-
     if(in.front() == '[')
     {
         //std::cout << this << " Creating list based packet from " << in << std::endl;
-        in.erase(in.begin());
+        in.remove_prefix(1);
         while(in.front() != ']')
         {
             //std::cout << this << " Creating list entry from " << in << std::endl;
             m_list.emplace_back(in);
 
             if(in.front() == ',')
-                in.erase(in.begin());
+                in.remove_prefix(1);
         }
-        in.erase(in.begin());
+        in.remove_prefix(1);
         //std::cout << this << " has completed list, remaining string is " << in << std::endl;
     }
-    else if(std::regex_search(in, match, regex))
-    {
-        //std::cout << this << " Creating value based packet from " << in << std::endl;
-        // Expected to be an integer
-        m_value = stoi(match[1]);
-        std::string whole = match[0];
-        in.erase(0, whole.size()); // Next entry in the list is now ready
-    }
     else
     {
-        std::cout << "Failed to parse " << in << std::endl;
-        throw 0;
+        // Expected to be an integer
+        m_value = parse_value(in);
     }
-
 }
 
 auto packet_t::print() const -> std::string
 {
-    
+
     if(m_value)
         return std::to_string(m_value.value());
-    
+
     std::string ret;
 
     std::for_each(m_list.begin(), m_list.end(), [&ret](auto & pkt)
@@ -122,20 +136,248 @@ auto packet_t::operator<(packet_t const & rhs) const -> bool
     }
 }
 
-auto part1(std::list<pair> pairs) -> std::size_t
+// Any number of packets, with all their nodes in one array in the order they appear in the text.
+// A list is followed by everything in it and knows where that ends, so its first entry is the
+// next node and each entry after that starts where the one before ends. Parsing is one pass
+// over the text, and after the first few packets doesn't allocate at all.
+class packets_t
+{
+public:
+    // Parse a packet, returning its index
+    auto add(std::string_view in) -> std::size_t
+    {
+        m_roots.push_back(static_cast<uint32_t>(m_nodes.size()));
+
+        while(!in.empty())
+        {
+            switch(in.front())
+            {
+            case '[':
+                m_open.push_back(static_cast<uint32_t>(m_nodes.size()));
+                m_nodes.push_back(node_t{0, 0, true});
+                in.remove_prefix(1);
+                break;
+            case ']':
+                if(m_open.empty())
+                {
+                    std::cout << "Unexpected ] before " << in << std::endl;
+                    throw 0;
+                }
+                m_nodes[m_open.back()].end = static_cast<uint32_t>(m_nodes.size());
+                m_open.pop_back();
+                in.remove_prefix(1);
+                break;
+            case ',':
+                in.remove_prefix(1);
+                break;
+            default:
+                m_nodes.push_back(node_t{parse_value(in), static_cast<uint32_t>(m_nodes.size() + 1), false});
+            }
+        }
+
+        if(!m_open.empty())
+        {
+            std::cout << "Unterminated list in packet " << m_roots.size() << std::endl;
+            throw 0;
+        }
+
+        return m_roots.size() - 1;
+    }
+
+    auto size() const -> std::size_t
+    {
+        return m_roots.size();
+    }
+
+    // Forget all the packets, keeping the memory for the next lot
+    void clear()
+    {
+        m_nodes.clear();
+        m_roots.clear();
+    }
+
+    auto compare(std::size_t lhs, std::size_t rhs) const -> std::strong_ordering
+    {
+        return compare_nodes(m_roots[lhs], m_roots[rhs]);
+    }
+
+    auto print(std::size_t packet) const -> std::string
+    {
+        std::string ret;
+        print(m_roots[packet], ret);
+        return ret;
+    }
+
+private:
+    struct node_t
+    {
+        int value;
+        uint32_t end;       // One past the last node in this one
+        bool list;
+    };
+
+    // An integer compared with a list is treated as a list of just itself, which is the range
+    // holding only its own node
+    auto compare_nodes(uint32_t lhs, uint32_t rhs) const -> std::strong_ordering
+    {
+        auto & l = m_nodes[lhs];
+        auto & r = m_nodes[rhs];
+
+        if(!l.list && !r.list)
+            return l.value <=> r.value;
+
+        auto lhs_end = l.end, rhs_end = r.end;
+        lhs += l.list ? 1 : 0;
+        rhs += r.list ? 1 : 0;
+
+        for(; lhs < lhs_end && rhs < rhs_end; lhs = m_nodes[lhs].end, rhs = m_nodes[rhs].end)
+        {
+            auto res = compare_nodes(lhs, rhs);
+            if(res != std::strong_ordering::equal)
+                return res;
+        }
+
+        // Whichever runs out first comes first
+        return (lhs_end - lhs) <=> (rhs_end - rhs);
+    }
+
+    void print(uint32_t node, std::string & out) const
+    {
+        auto & n = m_nodes[node];
+        if(!n.list)
+        {
+            out.append(std::to_string(n.value));
+            return;
+        }
+
+        out.push_back('[');
+        for(auto child = node + 1; child < n.end; child = m_nodes[child].end)
+        {
+            if(child != node + 1)
+                out.push_back(',');
+            print(child, out);
+        }
+        out.push_back(']');
+    }
+
+    std::vector<node_t> m_nodes;
+    std::vector<uint32_t> m_roots;
+    std::vector<uint32_t> m_open;   // Lists still being parsed
+};
+
+// One side of a comparison on the text. An integer compared with a list is treated as a list of
+// just itself without rewriting anything: the other side's [ is matched by a virtual one, and
+// the ] it owes is handed out as soon as the integer has been used.
+class text_cursor_t
+{
+public:
+    explicit text_cursor_t(std::string_view text)
+    : m_text{text}
+    {}
+
+    // The next bracket, or 0 for an integer
+    auto peek() -> char
+    {
+        if(m_closes)
+            return ']';
+
+        if(!m_text.empty() && m_text.front() == ',')
+            m_text.remove_prefix(1);
+
+        if(m_text.empty())
+            return ']';
+        return m_text.front() == '[' || m_text.front() == ']' ? m_text.front() : 0;
+    }
+
+    void skip()
+    {
+        if(m_closes)
+            --m_closes;
+        else
+            m_text.remove_prefix(1);
+    }
+
+    auto value() -> int
+    {
+        auto ret = parse_value(m_text);
+        m_closes += m_wraps;
+        m_wraps = 0;
+        return ret;
+    }
+
+    // Treat the integer coming up as a list holding it
+    void wrap()
+    {
+        ++m_wraps;
+    }
+
+    auto done() const -> bool
+    {
+        return m_text.empty() && !m_closes;
+    }
+
+private:
+    std::string_view m_text;
+    std::size_t m_wraps = 0;    // Virtual lists around the integer coming up
+    std::size_t m_closes = 0;   // And the closes they owe once it's used
+};
+
+// Compare two packets straight from their text, without building anything
+auto compare_text(std::string_view lhs, std::string_view rhs) -> std::strong_ordering
+{
+    text_cursor_t l{lhs}, r{rhs};
+
+    while(!l.done() || !r.done())
+    {
+        auto lc = l.peek(), rc = r.peek();
+
+        if(lc == rc && lc)
+        {
+            // Both opening or both closing
+            l.skip();
+            r.skip();
+        }
+        else if(lc == ']')
+        {
+            // Left list ran out first
+            return std::strong_ordering::less;
+        }
+        else if(rc == ']')
+        {
+            return std::strong_ordering::greater;
+        }
+        else if(lc == '[')
+        {
+            // Right is an integer, so it becomes a list
+            l.skip();
+            r.wrap();
+        }
+        else if(rc == '[')
+        {
+            l.wrap();
+            r.skip();
+        }
+        else
+        {
+            auto res = l.value() <=> r.value();
+            if(res != std::strong_ordering::equal)
+                return res;
+        }
+    }
+
+    return std::strong_ordering::equal;
+}
+
+auto part1(std::list<pair> const & pairs) -> std::size_t
 {
     std::size_t index = 0;
     std::size_t score = 0;
 
-    std::for_each(pairs.begin(), pairs.end(), [&index, &score](auto current)
+    std::for_each(pairs.begin(), pairs.end(), [&index, &score](auto const & current)
     {
         ++index;
         //std::cout << "Comparing " << current.first << " vs " << current.second << ":";
-        packet_t lhs{current.first};
-
-        packet_t rhs{current.second};
-
-        if(lhs < rhs)
+        if(compare_text(current.first, current.second) < 0)
         {
             //std::cout << " less than!";
             score += index;
@@ -148,48 +390,240 @@ auto part1(std::list<pair> pairs) -> std::size_t
     return score;
 }
 
-auto index_of(std::set<packet_t> const & packets, packet_t search) -> std::size_t
+// Run f on each index up to count, spread over some threads
+template<typename F>
+void parallel_for(std::size_t count, std::size_t threads, F && f)
 {
-    auto iter = packets.find(search);
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
 
-    if(iter == packets.end())
+    for(std::size_t t = 0; t < std::max<std::size_t>(threads, 1); ++t)
     {
-        throw 5;
+        workers.emplace_back([&next, count, &f]
+        {
+            for(auto i = next++; i < count; i = next++)
+                f(i);
+        });
     }
 
-    auto distance = std::distance(packets.begin(), iter);
+    std::for_each(workers.begin(), workers.end(), [](auto & worker){ worker.join(); });
+}
 
-    return 1 + distance;
+// Where each of some chunks of the packets starts, and finally where the last one ends
+auto chunks(std::size_t size, std::size_t count) -> std::vector<std::size_t>
+{
+    std::vector<std::size_t> ret;
+    for(std::size_t i = 0; i <= count; ++i)
+        ret.push_back(size * i / count);
+    return ret;
 }
 
-auto part2(std::list<pair> pairs)
+// How many packets come before the given one. Only where it would go is needed, not the order
+// of everything else, so it's one pass of comparisons split between the threads.
+auto rank(packets_t const & packets, std::size_t packet, std::size_t threads) -> std::size_t
 {
-    std::set<packet_t> packets;
+    threads = std::max<std::size_t>(threads, 1);
+    auto bounds = chunks(packets.size(), threads);
+    std::vector<std::size_t> counts(threads);
 
-    std::string div1_str{"[[2]]"};
-    std::string div2_str{"[[6]]"};
+    parallel_for(threads, threads, [&packets, packet, &bounds, &counts](std::size_t chunk)
+    {
+        auto indices = std::views::iota(bounds[chunk], bounds[chunk + 1]);
+        counts[chunk] = std::transform_reduce(indices.begin(), indices.end(), std::size_t{0}, std::plus<>{}, [&packets, packet](std::size_t i)
+        {
+            return packets.compare(i, packet) < 0 ? std::size_t{1} : std::size_t{0};
+        });
+    });
 
-    packet_t div1{div1_str};
-    packet_t div2{div2_str};
+    return std::accumulate(counts.begin(), counts.end(), std::size_t{0});
+}
 
-    packets.insert(div1);
-    packets.insert(div2);
+// All the packets in order, as indices into the arena. Each thread sorts a chunk, then
+// neighbouring chunks are merged in pairs, again in parallel, until there's only one.
+auto sort_packets(packets_t const & packets, std::size_t threads) -> std::vector<std::size_t>
+{
+    std::vector<std::size_t> ret(packets.size());
+    std::iota(ret.begin(), ret.end(), 0);
+
+    auto less = [&packets](std::size_t lhs, std::size_t rhs) { return packets.compare(lhs, rhs) < 0; };
+    auto bounds = chunks(ret.size(), std::max<std::size_t>(threads, 1));
 
-    std::for_each(pairs.begin(), pairs.end(), [&packets](auto current)
+    parallel_for(bounds.size() - 1, threads, [&ret, &bounds, &less](std::size_t chunk)
     {
-        packets.insert(packet_t{current.first});
-        packets.insert(packet_t{current.second});
+        std::sort(ret.begin() + bounds[chunk], ret.begin() + bounds[chunk + 1], less);
     });
 
-    return index_of(packets, div1) * index_of(packets, div2);
+    for(std::size_t width = 1; width < bounds.size() - 1; width *= 2)
+    {
+        auto merges = (bounds.size() - 1 + 2 * width - 1) / (2 * width);
+        parallel_for(merges, threads, [&ret, &bounds, &less, width](std::size_t merge)
+        {
+            auto first = merge * 2 * width;
+            auto middle = std::min(first + width, bounds.size() - 1);
+            auto last = std::min(first + 2 * width, bounds.size() - 1);
+            std::inplace_merge(ret.begin() + bounds[first], ret.begin() + bounds[middle], ret.begin() + bounds[last], less);
+        });
+    }
+
+    return ret;
 }
 
-int main()
+auto part2(std::list<pair> const & pairs, std::size_t threads)
 {
+    packets_t packets;
+
+    auto div1 = packets.add("[[2]]");
+    auto div2 = packets.add("[[6]]");
+
+    std::for_each(pairs.begin(), pairs.end(), [&packets](auto const & current)
+    {
+        packets.add(current.first);
+        packets.add(current.second);
+    });
+
+    return (1 + rank(packets, div1, threads)) * (1 + rank(packets, div2, threads));
+}
+
+// A random packet, nested no more than the given depth
+auto random_packet(std::mt19937 & gen, int depth, unsigned values = 11, unsigned entries = 6) -> std::string
+{
+    if(depth == 0 || gen() % 4 == 0)
+        return std::to_string(gen() % values);
+
+    std::string ret{"["};
+    for(auto entry = gen() % entries; entry > 0; --entry)
+    {
+        ret.append(random_packet(gen, depth - 1, values, entries));
+        if(entry > 1)
+            ret.push_back(',');
+    }
+    ret.push_back(']');
+
+    return ret;
+}
+
+// Lines of random packets adding up to at least the given size
+auto synthetic_packets(std::size_t bytes) -> std::string
+{
+    std::mt19937 gen(13);
+    std::string ret;
+
+    while(ret.size() < bytes)
+    {
+        ret.append("[" + random_packet(gen, 5) + "]");
+        ret.push_back('\n');
+    }
+    return ret;
+}
+
+// Parse every line of the text, returning how long it took in seconds
+template<typename parse_fn_t>
+auto time_parse(std::string_view text, parse_fn_t parse_fn) -> double
+{
+    auto start = std::chrono::steady_clock::now();
+
+    while(!text.empty())
+    {
+        auto line = text.substr(0, text.find('\n'));
+        parse_fn(line);
+        text.remove_prefix(std::min(text.size(), line.size() + 1));
+    }
+
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+}
+
+void bench(std::size_t megabytes, std::size_t threads)
+{
+    auto text = synthetic_packets(megabytes << 20);
+    auto mb = static_cast<double>(text.size()) / (1 << 20);
+
+    // Once to size the arena, then again as it would be reused
+    packets_t packets;
+    time_parse(text, [&packets](std::string_view line) { packets.add(line); });
+    packets.clear();
+    auto arena = time_parse(text, [&packets](std::string_view line) { packets.add(line); });
+
+    // For comparison, each packet as a tree of lists
+    auto tree = time_parse(text, [](std::string_view line) { packet_t{line}; });
+
+    std::cout << packets.size() << " packets, " << mb << " MB" << std::endl;
+    std::cout << "Arena: " << mb / arena << " MB/s" << std::endl;
+    std::cout << "Tree: " << mb / tree << " MB/s" << std::endl;
+
+    // Where a divider would go, then the full order, which had better agree
+    auto divider = packets.add("[[2]]");
+
+    auto start = std::chrono::steady_clock::now();
+    auto position = rank(packets, divider, threads);
+    std::chrono::duration<double> ranking = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    auto order = sort_packets(packets, threads);
+    std::chrono::duration<double> sorting = std::chrono::steady_clock::now() - start;
+
+    auto less = [&packets](std::size_t lhs, std::size_t rhs) { return packets.compare(lhs, rhs) < 0; };
+    auto sorted = std::is_sorted(order.begin(), order.end(), less) &&
+                  std::lower_bound(order.begin(), order.end(), divider, less) - order.begin() == static_cast<std::ptrdiff_t>(position);
+
+    std::cout << "Rank with " << threads << " threads: " << ranking.count() << "s" << std::endl;
+    std::cout << "Sort with " << threads << " threads: " << sorting.count() << "s" << (sorted ? "" : ", out of order") << std::endl;
+}
+
+// Compare random pairs of packets on the text, in the arena and as trees, checking all three
+// agree. Small values and short lists make for plenty of ties and integers against lists.
+auto check(std::size_t pairs) -> bool
+{
+    std::mt19937 gen(24);
+    packets_t packets;
+
+    for(std::size_t i = 0; i < pairs; ++i)
+    {
+        auto lhs = "[" + random_packet(gen, 4, 3, 4) + "]";
+        auto rhs = "[" + random_packet(gen, 4, 3, 4) + "]";
+
+        std::string_view lhs_view{lhs}, rhs_view{rhs};
+        packet_t lhs_tree{lhs_view}, rhs_tree{rhs_view};
+        auto tree = lhs_tree < rhs_tree ? std::strong_ordering::less
+                  : rhs_tree < lhs_tree ? std::strong_ordering::greater
+                  : std::strong_ordering::equal;
+
+        packets.clear();
+        auto arena = packets.compare(packets.add(lhs), packets.add(rhs));
+
+        if(compare_text(lhs, rhs) != tree || arena != tree)
+        {
+            std::cout << "Comparisons differ for " << lhs << " vs " << rhs << std::endl;
+            return false;
+        }
+    }
+
+    std::cout << "Text and arena comparisons match the tree on " << pairs << " pairs" << std::endl;
+    return true;
+}
+
+// Usage: main [threads], main bench [megabytes] [threads], or main check [pairs]
+int main(int argc, char * argv[])
+{
+    auto mode = std::string{argc > 1 ? argv[1] : ""};
+    auto threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+
+    if(mode == "bench")
+    {
+        bench(argc > 2 ? std::stoul(argv[2]) : 16, argc > 3 ? std::stoul(argv[3]) : threads);
+        return 0;
+    }
+
+    if(mode == "check")
+        return check(argc > 2 ? std::stoul(argv[2]) : 100000) ? 0 : 1;
+
     auto pairs = parse();
 
     std::cout << part1(pairs) << std::endl;
-    std::cout << part2(pairs) << std::endl;
+    if(argc > 1)
+        threads = std::stoul(argv[1]);
+
+    std::cout << part2(pairs, threads) << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,10 +1,21 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <iostream>
-#include <list>
 #include <map>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <regex>
-#include <set>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 using name_map = std::map<std::string, std::size_t>;
 
@@ -74,146 +85,121 @@ auto parse() -> map
     return ret;
 }
 
-auto shortest(name_t from, name_t to, map const & map) -> int
-{
-    if(from == to)
-        return 0;
-    //std::cout << "Finding shortest path between " << from << " and " << to << ": ";
-    auto & source = map.at(from);
+static constexpr int unreachable = -1;
 
-    // BFS from source until matching destination is reached
-    std::multimap<int, name_t> queue;
-    auto & dests = source.next;
+// Hop counts from one valve to every other, by BFS as every tunnel takes one minute
+auto hops_from(map const & graph, name_t source) -> std::vector<int>
+{
+    std::vector<int> dist(graph.size(), unreachable);
+    std::vector<name_t> queue;
+    queue.reserve(graph.size());
 
-    std::for_each(dests.begin(), dests.end(), [&queue](auto d)
-    {
-        //std::cout << "Initial queue includes " << f.second << std::endl;
-        queue.insert(d);
-    });
+    dist.at(source) = 0;
+    queue.push_back(source);
 
-    while(!queue.empty())
+    for(std::size_t head = 0; head < queue.size(); ++head)
     {
-        auto iter = queue.begin();
-        auto dist = iter->first;
-        auto & next = iter->second;
+        auto name = queue[head];
 
-        if(next == to)
+        for(auto const & neighbour : graph[name].next)
         {
-            // We've found it, and it must be the shortest so far
-            //std::cout << dist << std::endl;
-            return dist;
+            if(dist[neighbour.second] == unreachable)
+            {
+                dist[neighbour.second] = dist[name] + 1;
+                queue.push_back(neighbour.second);
+            }
         }
-
-        auto & source = map.at(next);
-        auto extra_hops = source.next;
-
-        std::for_each(extra_hops.begin(), extra_hops.end(), [&queue, dist](auto hop)
-        {
-            queue.insert(std::make_pair(dist + hop.first, hop.second));
-        });
-
-        queue.erase(iter);
     }
 
-    std::cout << "Failed to find any path from " << from << " to " << to << std::endl;
-    throw 7;
+    return dist;
 }
 
-using distances = std::map<name_t, int>;
-
-// Find shortest path from source to all other nodes
-auto Dijkstra(map const & graph, name_t source) -> distances
+auto shortest(name_t from, name_t to, map const & map) -> int
 {
-    std::set<name_t> visited{};
-    std::multimap<int, name_t> q{};
-
-    auto & node = graph.at(source);
-    auto & neighbours = node.next;
+    auto dist = hops_from(map, from).at(to);
 
-    std::for_each(neighbours.begin(), neighbours.end(), [&q](auto neighbour)
+    if(dist == unreachable)
     {
-        q.insert(neighbour);
-    });
+        std::cout << "Failed to find any path from " << from << " to " << to << std::endl;
+        throw 7;
+    }
 
-    distances dist;
+    return dist;
+}
 
-    while(!q.empty())
+// Dense row-major matrix of shortest distances between each pair of interesting valves
+struct distance_matrix_t
+{
+    auto at(std::size_t from, std::size_t to) const -> int
     {
-        auto iter = q.begin();
-
-        auto distance = iter->first;
-        auto name = iter->second;
+        return hops[from * size + to];
+    }
 
-        if(visited.insert(name).second)
-        {
-            // First time visiting this node, so add it to result if it's a new record
-            auto prev = dist.find(name);
-            if(prev == dist.end() || prev->second < distance)
-            {
-                dist.insert(std::make_pair(name, distance));
-            }
-            
-            // Now queue up all it's neighbours
-            auto & node = graph.at(name);
+    std::size_t size;
+    std::vector<int> hops;
+};
 
-            auto & neighbours = node.next;
+auto interesting_valves(map const & graph) -> std::vector<name_t>
+{
+    std::vector<name_t> interesting{0}; // AA is always interesting as it's the start node
 
-            std::for_each(neighbours.begin(), neighbours.end(), [&q, distance](auto neighbour)
-            {
-                // Enqueue this neighbour, adding current distance
-                q.insert(std::make_pair(neighbour.first + distance, neighbour.second));
-            });
+    // Filter the list of nodes to those with non-zero flow rate
+    for(std::size_t id = 1; id < graph.size(); ++id)
+    {
+        if(graph[id].rate > 0)
+        {
+            interesting.push_back(id);
         }
-
-        q.erase(iter);
     }
 
-    return dist;
+    return interesting;
 }
 
-// Figure out the distances between each pair of interesting nodes
-auto reduce(map const & graph) -> map
+// One BFS per interesting valve, keeping only the columns of other interesting valves
+auto distances(map const & graph, std::vector<name_t> const & interesting) -> distance_matrix_t
 {
-    std::set<name_t> interesting{0}; // AA is always interesting as it's the start node
+    distance_matrix_t matrix{interesting.size(), std::vector<int>(interesting.size() * interesting.size(), unreachable)};
 
-    // Filter the list of nodes to those with non-zero flow rate
-    for(std::size_t id = 0; id < graph.size(); ++id)
+    for(std::size_t from = 0; from < interesting.size(); ++from)
     {
-        if(graph[id].rate > 0)
+        auto dist = hops_from(graph, interesting[from]);
+
+        for(std::size_t to = 0; to < interesting.size(); ++to)
         {
-            interesting.insert(id);
+            matrix.hops[from * matrix.size + to] = dist[interesting[to]];
         }
     }
 
-    std::cout << "Found " << interesting.size() << " nodes of interest out of " << graph.size() << std::endl;
+    return matrix;
+}
+
+// Figure out the distances between each pair of interesting nodes, renumbering them
+// 0..k-1 (with AA as 0) so that a set of valves fits in a machine word
+auto reduce(map const & graph) -> map
+{
+    auto interesting = interesting_valves(graph);
 
-    // For each interesting node, find it's shortest path to neighbours
-    map reduced;
+    //std::cout << "Found " << interesting.size() << " nodes of interest out of " << graph.size() << std::endl;
 
-    reduced.resize(graph.size());
+    auto matrix = distances(graph, interesting);
 
-    // Create mapping between each pair of points
-    std::for_each(interesting.begin(), interesting.end(), [interesting, graph, &reduced](auto source)
-    {
-        reduced.at(source).rate = graph.at(source).rate;
-        
-        // New node
-        auto & next = reduced.at(source).next;
+    map reduced(interesting.size());
 
-        auto neighbours = Dijkstra(graph, source);
+    for(std::size_t from = 0; from < interesting.size(); ++from)
+    {
+        reduced[from].rate = graph.at(interesting[from]).rate;
 
-        // Only record the connections to interesting neighbours
-        std::for_each(neighbours.begin(), neighbours.end(), [&next, graph, interesting](auto neighbour)
+        // Only record the connections to other reachable interesting neighbours
+        for(std::size_t to = 0; to < interesting.size(); ++to)
         {
-            auto name = neighbour.first;
-            auto distance = neighbour.second;
+            auto distance = matrix.at(from, to);
 
-            if(interesting.contains(name))
+            if(to != from && distance != unreachable)
             {
-                next.push_back(std::make_pair(distance, name));
+                reduced[from].next.push_back(std::make_pair(distance, to));
             }
-        });
-    });
+        }
+    }
 
     return reduced;
 }
@@ -276,7 +262,178 @@ struct state_t
 static const state_t initial_state{30, 0, 0, 30, 0};
 static const state_t with_elephant{26, 0, 0, 0, 0};
 
-using state_history = std::map<state_t, int>;
+// Flat open-addressing memo of the best additional release reachable from a state.
+// Each state is packed into a single 64-bit key over a compact index of the valves
+// the reduced graph can visit, and slots live in one arena which starts small and doubles
+// as it fills, up to the memory cap. Once the arena is at its load limit at the cap, new
+// states are simply not remembered.
+class state_history
+{
+public:
+    static constexpr std::size_t default_memory_cap = std::size_t{256} << 20;
+
+    explicit state_history(map const & map, std::size_t memory_cap = default_memory_cap)
+    : m_index(map.size(), unindexed)
+    {
+        // Only valves with somewhere to go (or which are worth opening) can appear in a state
+        std::size_t count = 0;
+        for(std::size_t id = 0; id < map.size(); ++id)
+        {
+            if(id == 0 || map[id].rate > 0 || !map[id].next.empty())
+                m_index[id] = count++;
+        }
+
+        m_location_bits = bits_for(count);
+        if(2 * (time_bits + m_location_bits) + count >= 64)
+        {
+            std::cout << "Too many valves (" << count << ") to pack a state into 64 bits" << std::endl;
+            throw 5;
+        }
+
+        m_max_capacity = 1;
+        while(m_max_capacity * 2 * sizeof(slot_t) <= memory_cap)
+            m_max_capacity *= 2;
+
+        resize(std::min(initial_capacity, m_max_capacity));
+    }
+
+    auto find(state_t const & state) -> std::optional<int>
+    {
+        auto key = pack(state);
+
+        for(auto slot = home(key);; slot = (slot + 1) & (m_slots.size() - 1))
+        {
+            if(m_slots[slot].key == key)
+            {
+                ++m_hits;
+                return m_slots[slot].released;
+            }
+            if(m_slots[slot].key == empty)
+            {
+                ++m_misses;
+                return std::nullopt;
+            }
+        }
+    }
+
+    void insert(state_t const & state, int released)
+    {
+        if(m_size >= m_limit)
+        {
+            if(m_slots.size() >= m_max_capacity)
+            {
+                ++m_dropped;
+                return;
+            }
+            resize(m_slots.size() * 2);
+        }
+
+        auto key = pack(state);
+        auto slot = home(key);
+
+        while(m_slots[slot].key != empty && m_slots[slot].key != key)
+            slot = (slot + 1) & (m_slots.size() - 1);
+
+        if(m_slots[slot].key == empty)
+            ++m_size;
+        m_slots[slot] = slot_t{key, released};
+    }
+
+    void print_stats() const
+    {
+        std::cout << "Memo: " << m_hits << " hits, " << m_misses << " misses, "
+                  << m_size << "/" << m_slots.size() << " slots occupied ("
+                  << (100.0 * m_size / m_slots.size()) << "%), "
+                  << m_dropped << " inserts dropped at memory cap" << std::endl;
+    }
+
+private:
+    struct slot_t
+    {
+        std::uint64_t key;
+        int released;
+    };
+
+    static constexpr std::uint64_t empty = ~std::uint64_t{0};
+    static constexpr std::size_t unindexed = ~std::size_t{0};
+    static constexpr std::size_t initial_capacity = std::size_t{1} << 12;
+    static constexpr std::size_t time_bits = 6;
+
+    static auto bits_for(std::size_t value) -> std::size_t
+    {
+        std::size_t bits = 1;
+        while((std::size_t{1} << bits) <= value)
+            ++bits;
+        return bits;
+    }
+
+    auto compact(name_t name) const -> std::uint64_t
+    {
+        auto index = m_index.at(name);
+        if(index == unindexed)
+        {
+            std::cout << "Valve " << name << " is not part of the reduced graph" << std::endl;
+            throw 5;
+        }
+        return index;
+    }
+
+    auto pack(state_t const & state) const -> std::uint64_t
+    {
+        std::uint64_t opened = 0;
+        auto bits = state.opened.to_ullong();
+        while(bits)
+        {
+            opened |= std::uint64_t{1} << compact(std::countr_zero(bits));
+            bits &= bits - 1;
+        }
+
+        std::uint64_t key = opened;
+        key = (key << time_bits) | static_cast<std::uint64_t>(state.remaining_time);
+        key = (key << time_bits) | static_cast<std::uint64_t>(state.elephant_wait);
+        key = (key << m_location_bits) | compact(state.location);
+        key = (key << m_location_bits) | compact(state.elephant_location);
+        return key;
+    }
+
+    // Move every remembered state into an arena of the given size
+    void resize(std::size_t capacity)
+    {
+        auto old = std::exchange(m_slots, std::vector<slot_t>(capacity, slot_t{empty, 0}));
+        m_shift = 64 - bits_for(capacity - 1);
+        m_limit = capacity - capacity / 4;
+
+        for(auto const & entry : old)
+        {
+            if(entry.key == empty)
+                continue;
+
+            auto slot = home(entry.key);
+            while(m_slots[slot].key != empty)
+                slot = (slot + 1) & (capacity - 1);
+            m_slots[slot] = entry;
+        }
+    }
+
+    auto home(std::uint64_t key) const -> std::size_t
+    {
+        // Fibonacci hashing spreads the densely packed low bits across the table
+        return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    std::vector<name_t> m_index;
+    std::size_t m_location_bits;
+
+    std::vector<slot_t> m_slots;
+    std::size_t m_max_capacity;
+    std::size_t m_shift;
+    std::size_t m_limit;
+    std::size_t m_size = 0;
+
+    std::size_t m_hits = 0;
+    std::size_t m_misses = 0;
+    std::size_t m_dropped = 0;
+};
 
 auto open(map const & map, state_history & history, state_t state, int released_flow) -> int;
 auto explore(map const & map, state_history & history, state_t state, int released_flow) -> int;
@@ -286,14 +443,14 @@ auto max(map const & map, state_history & history, state_t state = initial_state
     // If our state matches a previous call to max, we already know the answer!
     auto found = history.find(state);
 
-    if(found != history.end())
+    if(found)
     {
-        //std::cout << "Found previously reached state (from " << state.location << " with " << state.remaining_time << " minutes remaining), which is known to have a best additional release of " << found->second << std::endl;
-        return released_flow + found->second;
+        //std::cout << "Found previously reached state (from " << state.location << " with " << state.remaining_time << " minutes remaining), which is known to have a best additional release of " << *found << std::endl;
+        return released_flow + *found;
     }
 
-    if(state.remaining_time > 20)
-        std::cout << "Finding max from " << state.location << " with " << state.remaining_time << " minutes remaining. We've already released " << released_flow << std::endl;
+    //if(state.remaining_time > 20)
+        //std::cout << "Finding max from " << state.location << " with " << state.remaining_time << " minutes remaining. We've already released " << released_flow << std::endl;
     
     // Model opening this valve
     auto best = open(map, history, state, released_flow);
@@ -308,7 +465,7 @@ auto max(map const & map, state_history & history, state_t state = initial_state
         std::cout << "We just released negative pressure: from " << state.location << " with " << state.remaining_time << " minutes remaining." << std::endl;
         throw 5;
     }
-    history.insert(std::make_pair(state, best - released_flow));
+    history.insert(state, released);
 
     return best;
 }
@@ -319,7 +476,7 @@ auto explore(map const & map, state_history & history, state_t current_state, in
     auto & next = map.at(current_state.location).next;
 
     // Use accumulate, but actually just for max
-    return std::accumulate(next.begin(), next.end(), released_flow, [map, &history, released_flow, current_state](int best, auto destination)
+    return std::accumulate(next.begin(), next.end(), released_flow, [&map, &history, released_flow, current_state](int best, auto const & destination)
     {
         auto state = current_state;
         // Walk to this destination, if possible
@@ -363,29 +520,469 @@ auto open(map const & map, state_history & history, state_t state, int released_
         return released_flow;
 }
 
-auto part1(map const & map) -> std::size_t
+auto part1(map const & map, bool stats = false) -> std::size_t
 {
-    state_history history;
+    state_history history{map};
 
-    return max(map, history);//, 0, short_state);
+    auto best = max(map, history);//, 0, short_state);
+    if(stats)
+        history.print_stats();
+    return best;
 }
 
-auto part2(map const & map) -> std::size_t
+auto part2(map const & map, bool stats = false) -> std::size_t
 {
-    state_history history;
+    state_history history{map};
 
-    return max(map, history, with_elephant);
+    auto best = max(map, history, with_elephant);
+    if(stats)
+        history.print_stats();
+    return best;
 }
 
-int main()
+// Alternative solver: the best release a single actor can achieve for every set of opened
+// valves, which can then be shared out between any number of cooperating actors
+using release_table = std::vector<int>;
+
+static constexpr std::size_t dp_memory_cap = std::size_t{1} << 30;
+
+auto single_actor(map const & map, int minutes) -> release_table
 {
+    // Bit b of a mask stands for the b'th valve worth opening
+    std::vector<name_t> openable;
+    std::vector<std::size_t> bit_of(map.size(), map.size());
+
+    for(name_t id = 0; id < map.size(); ++id)
+    {
+        if(map[id].rate > 0)
+        {
+            bit_of[id] = openable.size();
+            openable.push_back(id);
+        }
+    }
+
+    auto valves = openable.size();
+    auto locations = map.size();
+    auto sets = std::size_t{1} << valves;
+    auto states = (minutes + 1) * locations * sets;
+
+    if(valves >= 32 || states > dp_memory_cap / sizeof(int))
+    {
+        std::cout << "Too many valves (" << valves << ") for the bitmask solver" << std::endl;
+        throw 5;
+    }
+
+    // Minutes from each location to each openable valve
+    std::vector<int> dist(locations * valves, unreachable);
+    for(name_t from = 0; from < locations; ++from)
+    {
+        if(bit_of[from] < valves)
+            dist[from * valves + bit_of[from]] = 0;
+
+        for(auto const & neighbour : map[from].next)
+        {
+            if(bit_of[neighbour.second] < valves)
+                dist[from * valves + bit_of[neighbour.second]] = neighbour.first;
+        }
+    }
+
+    // Best release so far having opened mask and standing at location with t minutes left
+    std::vector<int> released(states, unreachable);
+    auto at = [&released, locations, sets](int t, name_t location, std::size_t mask) -> int &
+    {
+        return released[(t * locations + location) * sets + mask];
+    };
+
+    at(minutes, 0, 0) = 0;
+
+    release_table best(sets, 0);
+
+    // Every move costs time, so states only ever feed into those with less remaining
+    for(int t = minutes; t > 0; --t)
+    {
+        for(name_t location = 0; location < locations; ++location)
+        {
+            for(std::size_t mask = 0; mask < sets; ++mask)
+            {
+                auto so_far = at(t, location, mask);
+                if(so_far == unreachable)
+                    continue;
+
+                best[mask] = std::max(best[mask], so_far);
+
+                for(std::size_t bit = 0; bit < valves; ++bit)
+                {
+                    auto d = dist[location * valves + bit];
+                    if(mask & (std::size_t{1} << bit) || d == unreachable)
+                        continue;
+
+                    // Walk there and spend a minute opening it
+                    auto left = t - d - 1;
+                    if(left <= 0)
+                        continue;
+
+                    auto & next = at(left, openable[bit], mask | (std::size_t{1} << bit));
+                    next = std::max(next, so_far + map[openable[bit]].rate * left);
+                }
+            }
+        }
+    }
+
+    // Max transform over subsets, so best[mask] is the best using any of the valves in mask
+    for(std::size_t bit = 0; bit < valves; ++bit)
+    {
+        for(std::size_t mask = 0; mask < sets; ++mask)
+        {
+            if(mask & (std::size_t{1} << bit))
+                best[mask] = std::max(best[mask], best[mask ^ (std::size_t{1} << bit)]);
+        }
+    }
+
+    return best;
+}
+
+// Share the valves between actors, each taking a disjoint subset
+auto cooperate(release_table const & single, std::size_t actors) -> int
+{
+    auto full = single.size() - 1;
+    auto team = single;
+
+    for(std::size_t actor = 1; actor < actors; ++actor)
+    {
+        // The last actor to join only needs to complete the full set
+        auto first = (actor + 1 == actors) ? full : 0;
+        release_table joined(single.size(), 0);
+
+        for(auto mask = first; mask <= full; ++mask)
+        {
+            for(auto subset = mask;; subset = (subset - 1) & mask)
+            {
+                joined[mask] = std::max(joined[mask], team[subset] + single[mask ^ subset]);
+                if(subset == 0)
+                    break;
+            }
+        }
+
+        team = std::move(joined);
+    }
+
+    return team[full];
+}
+
+auto part1_dp(map const & map) -> std::size_t
+{
+    return cooperate(single_actor(map, initial_state.remaining_time), 1);
+}
+
+auto part2_dp(map const & map, std::size_t actors) -> std::size_t
+{
+    return cooperate(single_actor(map, with_elephant.remaining_time), actors);
+}
+
+// Tasks are dealt out to per-worker deques up front. Each worker pops from the back of
+// its own deque and, once that is empty, steals from the front of the others.
+template<typename task_t>
+class work_stealing_pool
+{
+public:
+    explicit work_stealing_pool(std::size_t threads)
+    : m_queues(std::max<std::size_t>(threads, 1))
+    {
+    }
+
+    template<typename F>
+    void run(std::vector<task_t> tasks, F && work)
+    {
+        for(std::size_t i = 0; i < tasks.size(); ++i)
+        {
+            m_queues[i % m_queues.size()].tasks.push_back(std::move(tasks[i]));
+        }
+
+        std::vector<std::thread> workers;
+        for(std::size_t id = 0; id < m_queues.size(); ++id)
+        {
+            workers.emplace_back([this, id, &work]
+            {
+                task_t task;
+                while(next(id, task))
+                {
+                    work(id, task);
+                }
+            });
+        }
+
+        std::for_each(workers.begin(), workers.end(), [](auto & worker){ worker.join(); });
+    }
+
+    auto size() const -> std::size_t
+    {
+        return m_queues.size();
+    }
+
+private:
+    struct queue_t
+    {
+        std::mutex lock;
+        std::deque<task_t> tasks;
+    };
+
+    auto next(std::size_t id, task_t & task) -> bool
+    {
+        // No task ever spawns more, so once every deque is empty we're done
+        for(std::size_t i = 0; i < m_queues.size(); ++i)
+        {
+            auto & queue = m_queues[(id + i) % m_queues.size()];
+            std::lock_guard guard{queue.lock};
+
+            if(!queue.tasks.empty())
+            {
+                if(i == 0)
+                {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+                else
+                {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::vector<queue_t> m_queues;
+};
+
+// Branch and bound over valve openings. Every move walks the acting actor to an
+// unopened valve and opens it (or retires the actor for good), and any branch
+// whose optimistic bound can't beat the best release found by any thread is cut.
+class parallel_search
+{
+public:
+    parallel_search(map const & map, std::size_t threads)
+    : m_map{map}
+    , m_pool{threads}
+    {
+        for(name_t id = 0; id < map.size(); ++id)
+        {
+            if(map[id].rate > 0)
+                m_by_rate.push_back(id);
+        }
+
+        std::sort(m_by_rate.begin(), m_by_rate.end(), [&map](auto lhs, auto rhs)
+        {
+            return map[lhs].rate > map[rhs].rate;
+        });
+    }
+
+    auto run(state_t initial) -> int
+    {
+        m_best = 0;
+
+        // Expand the first few moves serially, so there's plenty of work to share around
+        std::vector<task_t> tasks{task_t{initial, 0}};
+        for(int depth = 0; depth < split_depth && tasks.size() < m_pool.size() * tasks_per_thread; ++depth)
+        {
+            std::vector<task_t> deeper;
+            std::for_each(tasks.begin(), tasks.end(), [this, &deeper](auto const & task)
+            {
+                improve(task.released);
+                for_each_move(task, [&deeper](task_t const & child){ deeper.push_back(child); });
+            });
+            tasks = std::move(deeper);
+        }
+
+        // Each thread keeps its own record of the best release on reaching a state
+        std::vector<state_history> seen;
+        seen.reserve(m_pool.size());
+        for(std::size_t id = 0; id < m_pool.size(); ++id)
+        {
+            seen.emplace_back(m_map, state_history::default_memory_cap / m_pool.size());
+        }
+
+        m_pool.run(std::move(tasks), [this, &seen](std::size_t id, task_t const & task)
+        {
+            search(task, seen[id]);
+        });
+
+        return m_best;
+    }
+
+private:
+    struct task_t
+    {
+        state_t state;
+        int released;
+    };
+
+    static constexpr int split_depth = 3;
+    static constexpr std::size_t tasks_per_thread = 16;
+
+    // Open every unopened valve, biggest first, as early as either actor possibly could
+    auto bound(task_t const & task) const -> int
+    {
+        auto & state = task.state;
+        std::array<int, 2> next{state.remaining_time - 2, state.remaining_time - state.elephant_wait - 2};
+        auto bound = task.released;
+
+        for(auto valve : m_by_rate)
+        {
+            if(state.opened.test(valve))
+                continue;
+
+            auto & soonest = next[0] >= next[1] ? next[0] : next[1];
+            if(soonest <= 0)
+                break;
+
+            bound += m_map[valve].rate * soonest;
+            soonest -= 2;
+        }
+
+        return bound;
+    }
+
+    template<typename F>
+    void for_each_move(task_t const & task, F && f) const
+    {
+        auto & state = task.state;
+
+        for(auto const & destination : m_map[state.location].next)
+        {
+            auto valve = destination.second;
+            auto left = state.remaining_time - destination.first - 1;
+
+            if(left <= 0 || state.opened.test(valve) || m_map[valve].rate == 0)
+                continue;
+
+            task_t child{state, task.released + m_map[valve].rate * left};
+            child.state.location = valve;
+            child.state.opened.set(valve);
+            child.state.reduce_time(destination.first + 1);
+            f(child);
+        }
+
+        // Leave the rest to the other actor, if it still has time to open anything
+        auto other = state.remaining_time - state.elephant_wait;
+        if(other > 1)
+        {
+            task_t child{state, task.released};
+            std::swap(child.state.location, child.state.elephant_location);
+            child.state.remaining_time = other;
+            child.state.elephant_wait = other;
+            f(child);
+        }
+    }
+
+    void improve(int released)
+    {
+        auto best = m_best.load(std::memory_order_relaxed);
+        while(released > best && !m_best.compare_exchange_weak(best, released, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void search(task_t const & task, state_history & seen)
+    {
+        improve(task.released);
+
+        if(bound(task) <= m_best.load(std::memory_order_relaxed))
+            return;
+
+        // Arriving somewhere we've already been with at least as much released can't do better
+        auto found = seen.find(task.state);
+        if(found && *found >= task.released)
+            return;
+        seen.insert(task.state, task.released);
+
+        for_each_move(task, [this, &seen](task_t const & child){ search(child, seen); });
+    }
+
+    map const & m_map;
+    work_stealing_pool<task_t> m_pool;
+    std::vector<name_t> m_by_rate;
+    std::atomic<int> m_best;
+};
+
+auto part1_parallel(map const & map, std::size_t threads) -> std::size_t
+{
+    return parallel_search{map, threads}.run(initial_state);
+}
+
+auto part2_parallel(map const & map, std::size_t threads) -> std::size_t
+{
+    return parallel_search{map, threads}.run(with_elephant);
+}
+
+// With stats, reports how long it took
+template<typename F>
+auto timed(F && f, bool stats) -> std::size_t
+{
+    auto start = std::chrono::steady_clock::now();
+    auto ret = f();
+    auto took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    if(stats)
+        std::cout << "Took " << took.count() << "us" << std::endl;
+    return ret;
+}
+
+// Usage: main [search|dp|parallel] [actors for part 2 with dp, or threads with parallel] [stats],
+// where stats reports how long each part took and, for search, how the memo was used
+int main(int argc, char * argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "search";
+
+    if(mode != "search" && mode != "dp" && mode != "parallel")
+    {
+        std::cout << "Unknown solver " << mode << ", expected search, dp or parallel" << std::endl;
+        return 1;
+    }
+
+    std::size_t actors = 2;
+    std::size_t threads = std::thread::hardware_concurrency();
+    bool stats = false;
+
+    for(int arg = 2; arg < argc; ++arg)
+    {
+        if(std::string{argv[arg]} == "stats")
+            stats = true;
+        else
+            (mode == "parallel" ? threads : actors) = std::stoul(argv[arg]);
+    }
+
+    if(actors < 1 || (mode != "dp" && actors != 2))
+    {
+        std::cout << "Only the dp solver supports anything other than a human and an elephant" << std::endl;
+        return 1;
+    }
+
     auto valves = parse();
 
     auto reduced = reduce(valves);
 
-    std::cout << part1(reduced) << std::endl;
+    if(mode == "dp")
+    {
+        std::cout << timed([&reduced]{ return part1_dp(reduced); }, stats) << std::endl;
+
+        std::cout << timed([&reduced, actors]{ return part2_dp(reduced, actors); }, stats) << std::endl;
 
-    std::cout << part2(reduced) << std::endl;
+        return 0;
+    }
+
+    if(mode == "parallel")
+    {
+        std::cout << timed([&reduced, threads]{ return part1_parallel(reduced, threads); }, stats) << std::endl;
+
+        std::cout << timed([&reduced, threads]{ return part2_parallel(reduced, threads); }, stats) << std::endl;
+
+        return 0;
+    }
+
+    std::cout << timed([&reduced, stats]{ return part1(reduced, stats); }, stats) << std::endl;
+
+    std::cout << timed([&reduced, stats]{ return part2(reduced, stats); }, stats) << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,24 +1,31 @@
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-//using shape_t = uint64_t;
-//using chamber_t = uint64_t;
+using rows_t = std::vector<uint8_t>;
 
-using shape_t = std::vector<uint8_t>;
-using chamber_t = std::vector<uint8_t>;
-using shapes_t = std::vector<shape_t>;
+// A shape is up to four rows of the chamber packed into one word, bottom row in the low byte,
+// so it lines up with four consecutive rows read straight out of the chamber
+using shape_t = uint32_t;
 
-shapes_t shapes = {{0x1e}, {0x08, 0x1c, 0x08}, {0x04, 0x04, 0x1c}, {0x10, 0x10, 0x10, 0x10}, {0x18, 0x18}};
+constexpr std::array<shape_t, 5> shapes{0x0000001e,
+                                        0x00081c08,
+                                        0x0004041c,
+                                        0x10101010,
+                                        0x00001818};
 
-/*constexpr std::array<shape_t, 5> shapes{0x0000001e00000000,
-                                        0x0000081c00000000,
-                                        0x0004041c00000000,
-                                        0x1010101000000000,
-                                        0x0000181800000000};*/
+constexpr shape_t left_wall = 0x40404040;
+constexpr shape_t right_wall = 0x01010101;
 
 struct wind_t
 {
@@ -28,7 +35,7 @@ struct wind_t
 
     auto next_left() -> bool
     {
-        auto ch = pattern.at(index);
+        auto ch = pattern[index];
         ++index;
 
         if(index == pattern.size())
@@ -47,41 +54,127 @@ auto parse_wind() -> wind_t
     return wind_t{line};
 }
 
-auto shift(shape_t const & shape, chamber_t const & chamber, bool left) -> shape_t
+// The rows of the chamber indexed upwards from the floor at level 0, so adding a row on top
+// never moves the others. Only the rows a falling shape could still reach are kept: those
+// below are dropped from the bottom of the buffer, while levels keep counting from the floor.
+// There are always enough empty rows above the tower for a new shape, so any four rows a
+// shape can occupy are read and written as a single word.
+//
+// Rows are only dropped beneath one that blocks every way down, found within the top few
+// hundred rows. If the wind never fills some column nothing is ever dropped, and the buffer
+// grows with the tower at a couple of bytes a rock.
+class chamber_t
 {
-    auto shifted = shape;
-    for(std::size_t i = 0; i < shape.size(); ++i)
+public:
+    chamber_t()
+    : m_rows(1 + headroom, 0x00)
     {
-        if(left)
-        {
-            shifted.at(i) = shape.at(i) << 1;
-            if(shape.at(i) & 0xc0)
-                return shape;
-        }
-        else
+        m_rows[0] = 0x7f;
+    }
+
+    // Level of the highest row with any rock in it
+    auto height() const -> std::size_t
+    {
+        return m_height;
+    }
+
+    // The four rows from this level up, in the same layout as a shape. Nothing falls below
+    // the rows we've kept, so the level is always one of them.
+    auto window(std::size_t level) const -> shape_t
+    {
+        shape_t ret;
+        std::memcpy(&ret, &m_rows[index(level)], sizeof(ret));
+        return ret;
+    }
+
+    // Add a shape with its bottom row at the given level
+    void place(shape_t shape, std::size_t level)
+    {
+        auto merged = window(level) | shape;
+        std::memcpy(&m_rows[index(level)], &merged, sizeof(merged));
+
+        // Top row of the shape is the highest non-zero byte
+        auto top = level + (std::bit_width(shape) - 1) / 8;
+        if(top > m_height)
         {
-            shifted.at(i) = shape.at(i) >> 1;
-            if(shape.at(i) & 0x01)
-                return shape;
+            m_height = top;
+            if(index(m_height) + headroom >= m_rows.size())
+                m_rows.resize(index(m_height) + headroom + 1, 0x00);
         }
-        if(shifted.at(i) & chamber.at(i))
-            return shape;
+
+        trim();
     }
 
-    return shifted;
-}
+    // How many rows we've kept
+    auto depth() const -> std::size_t
+    {
+        return m_height + 1 - m_base;
+    }
 
-auto check_hit(shape_t const & shape, chamber_t const & chamber) -> bool
-{
-    auto limit = std::min(shape.size(), chamber.size());
+    // The rows we've kept, top first
+    auto top_rows() const -> rows_t
+    {
+        auto top = m_rows.begin() + index(m_height) + 1;
+        return rows_t(std::make_reverse_iterator(top), m_rows.rend() - m_start);
+    }
+
+private:
+    // A new shape starts with three empty rows beneath it and is up to four rows high
+    static constexpr std::size_t headroom = 3 + 4;
 
-    for(size_t i = 0; i < limit; ++i)
+    // How far down from the top to look for a row which blocks every way down
+    static constexpr std::size_t max_scan = 256;
+
+    auto index(std::size_t level) const -> std::size_t
     {
-        if(shape.at(i) & chamber.at(i))
-            return true;
+        return m_start + level - m_base;
     }
-    return false;
-}
+
+    auto row(std::size_t level) const -> uint8_t
+    {
+        return m_rows[index(level)];
+    }
+
+    // Find the first row down from the top with no open cell a shape could fall or slide into,
+    // and forget everything beneath it. Giving up after a while keeps each rock's work bounded
+    // when there's no such row.
+    void trim()
+    {
+        uint8_t reachable = 0x7f;
+        auto level = height();
+
+        for(; reachable && level > m_base && height() - level < max_scan; --level)
+        {
+            uint8_t open = ~row(level) & 0x7f;
+
+            // Fall into this row, then spread sideways through any open cells
+            reachable &= open;
+            for(uint8_t prev = 0; prev != reachable;)
+            {
+                prev = reachable;
+                reachable |= ((reachable << 1) | (reachable >> 1)) & open;
+            }
+        }
+
+        // The loop steps one past the blocking row
+        auto keep_from = reachable ? m_base : level + 1;
+        m_start += keep_from - m_base;
+        m_base = keep_from;
+
+        // Reclaim the dropped rows once they make up most of the buffer, so each row is moved
+        // at most a constant number of times on average
+        if(m_start > 64 && m_start * 2 > m_rows.size())
+        {
+            m_rows.erase(m_rows.begin(), m_rows.begin() + m_start);
+            m_start = 0;
+        }
+    }
+
+    rows_t m_rows;
+    std::size_t m_start = 0;    // Index of the lowest row we've kept
+    std::size_t m_base = 0;     // And its level
+    std::size_t m_height = 0;
+};
 
 auto print(std::vector<uint8_t> const & v) -> std::string
 {
@@ -93,94 +186,148 @@ auto print(std::vector<uint8_t> const & v) -> std::string
     return o.str();
 }
 
-void add_shape(shape_t const & shape, chamber_t & chamber)
+// Whether the shape, with its bottom row at this level, overlaps any rock
+auto check_hit(shape_t shape, chamber_t const & chamber, std::size_t level) -> bool
 {
-    //std::cout << "Adding " << print(shape) << " to " << print(chamber) << std::endl;
-    auto limit = std::min(shape.size(), chamber.size());
+    return shape & chamber.window(level);
+}
 
-    for(size_t i = 0; i < limit; ++i)
-    {
-        chamber.at(i) |= shape.at(i);
-    }
+void shift(shape_t & shape, chamber_t const & chamber, std::size_t level, bool left)
+{
+    // Would hit the wall
+    if(shape & (left ? left_wall : right_wall))
+        return;
 
-    // Remove any leading zeros
-    while(chamber.front() == 0x00)
-    {
-        chamber.erase(chamber.begin());
-    }
+    auto shifted = left ? shape << 1 : shape >> 1;
+    if(!check_hit(shifted, chamber, level))
+        shape = shifted;
 }
 
 void process_shape(wind_t & wind, chamber_t & chamber, shape_t shape)
 {
-    // Pad chamber to be 3 empty rows under shape
-    chamber.insert(chamber.begin(), shape.size() + 3, 0x00);
-
-    //std::cout << "Adding shape of length " << shape.size() << " to chamber " << chamber.size() << std::endl;
+    // Bottom of the shape starts with 3 empty rows beneath it
+    auto level = chamber.height() + 4;
 
     while(true)
     {
         // Shift based on wind, if possible
-        auto left = wind.next_left();
-
-        auto shifted = shift(shape, chamber, left);
-
-        //std::cout << "Blown shape now " << print(shifted) << std::endl;
-
-        auto dropped = shifted;
-
-        // Move shape down
-        dropped.insert(dropped.begin(), 1, 0x00);
-
-        //std::cout << "Dropped shape now " << print(dropped) << std::endl;
-
-        if(dropped.size() > chamber.size())
-        {
-            throw 5;
-        }
+        shift(shape, chamber, level, wind.next_left());
 
-        if(check_hit(dropped, chamber))
+        if(check_hit(shape, chamber, level - 1))
         {
             // Merge shape into chamber
-            add_shape(shifted, chamber);
+            chamber.place(shape, level);
             // We're done
             return;
         }
 
-        shape = dropped;
+        // Move shape down
+        --level;
     }
 }
 
-auto chamber_state(chamber_t const & chamber) -> std::pair<chamber_t, std::size_t>
+// The most rows of the top of the chamber a state can hold. Real winds keep the reachable top to
+// a few dozen rows, but one which never blocks some column leaves it open all the way down.
+constexpr std::size_t max_state_rows = 256;
+
+// How many rocks in a row may leave the top deeper than that before giving up on cycles
+constexpr std::size_t max_deep_rocks = 100000;
+
+// The rows at the top of the chamber which a falling shape could still reach, down to and
+// including the first row with nowhere left to fall, along with the height of the tower.
+// Shapes only ever move down and sideways, so nothing below those rows can change again.
+// There's no state when the rows reach deeper than we're willing to remember.
+auto chamber_state(chamber_t const & chamber) -> std::optional<std::pair<rows_t, std::size_t>>
+{
+    if(chamber.depth() > max_state_rows)
+        return std::nullopt;
+
+    return std::make_pair(chamber.top_rows(), chamber.height());
+}
+
+// Drop the given number of rocks, returning the height of the tower. Once the next shape,
+// the position in the wind and the reachable top of the chamber repeat, everything after
+// repeats too, so whole cycles are skipped and only the remainder is simulated.
+auto simulate(wind_t wind, std::size_t rocks, bool skip_cycles = true) -> std::size_t
 {
-    auto iter = chamber.begin();
-    chamber_t ret;
-    uint8_t check = 0x7f;
+    chamber_t chamber;
+    std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> seen;
+    std::size_t skipped = 0;
+    std::size_t deep = 0;
 
-    while(check && iter != chamber.end())
+    for(std::size_t i = 0; i < rocks; ++i)
     {
-        auto ch = *iter;
+        if(skip_cycles && !skipped)
+        {
+            auto state = chamber_state(chamber);
+            if(!state)
+            {
+                if(++deep > max_deep_rocks)
+                {
+                    std::cout << "The top of the chamber stayed open more than " << max_state_rows
+                              << " rows deep for " << max_deep_rocks << " rocks, so can't find a cycle" << std::endl;
+                    throw 0;
+                }
+            }
+            else
+            {
+                deep = 0;
+                auto & [rows, height] = *state;
+                auto shape = i % shapes.size();
+
+                std::string key(reinterpret_cast<char const *>(&shape), sizeof(shape));
+                key.append(reinterpret_cast<char const *>(&wind.index), sizeof(wind.index));
+                key.append(rows.begin(), rows.end());
+
+                auto [found, inserted] = seen.try_emplace(key, i, height);
+                if(!inserted)
+                {
+                    auto [previous, previous_height] = found->second;
+                    auto cycle = i - previous;
+                    auto cycles = (rocks - i) / cycle;
+
+                    skipped = cycles * (height - previous_height);
+                    i += cycles * cycle;
+
+                    if(i == rocks)
+                        break;
+                }
+            }
+        }
 
-        ret.push_back(ch);
-        ++iter;
-        check = check & ~ch;
+        process_shape(wind, chamber, shapes[i % shapes.size()]);
     }
 
-    //return std::make_pairret
+    return chamber.height() + skipped;
+}
+
+// Drop rocks one by one, without skipping cycles, and report how fast they fall
+void bench(wind_t const & wind, std::size_t rocks)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto height = simulate(wind, rocks, false);
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+    std::cout << height << std::endl;
+    std::cout << rocks << " rocks in " << took.count() << "s, "
+              << static_cast<std::size_t>(rocks / took.count()) << " rocks/s" << std::endl;
 }
 
-int main()
+// Usage: main, or main bench [rocks]
+int main(int argc, char * argv[])
 {
     auto wind = parse_wind();
-    chamber_t chamber{0x7f};
 
-    for(int i = 0; i < 2022; ++i)
+    if(argc > 1 && std::string{argv[1]} == "bench")
     {
-        process_shape(wind, chamber, shapes.at(i % shapes.size()));
-        //std::cout << print(chamber) << std::endl;
+        bench(wind, argc > 2 ? std::stoull(argv[2]) : 10000000);
+        return 0;
     }
 
-    std::cout << chamber.size() - 1 << std::endl;
+    std::cout << simulate(wind, 2022) << std::endl;
 
     // Part 2
+    std::cout << simulate(wind, 1000000000000) << std::endl;
+
     return 0;
-}
\ No newline at end of file
+}
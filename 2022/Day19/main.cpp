@@ -1,14 +1,139 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <regex>
 #include <sstream>
 #include <string>
-
-static std::size_t num_rounds = 24;
+#include <thread>
+#include <unordered_map>
 
 using costs_t = std::array<int, 4>;
 
+// Four 16-bit counters packed into one word, one for each mineral type, so that a whole
+// set of robots or minerals is added, scaled and compared with a few word operations.
+// Counters must stay below 0x8000, as the top bit of each is used to catch borrows.
+class counts_t
+{
+public:
+    constexpr explicit counts_t(std::uint64_t word = 0)
+    : m_word{word}
+    {
+    }
+
+    static constexpr auto from(costs_t const & counts) -> counts_t
+    {
+        std::uint64_t word = 0;
+        for(int type = 3; type >= 0; --type)
+            word = (word << 16) | static_cast<std::uint16_t>(counts[type]);
+        return counts_t{word};
+    }
+
+    constexpr auto operator[](int type) const -> int
+    {
+        return static_cast<int>((m_word >> (16 * type)) & 0xFFFF);
+    }
+
+    constexpr auto add(int type, int count) const -> counts_t
+    {
+        return counts_t{m_word + (static_cast<std::uint64_t>(count) << (16 * type))};
+    }
+
+    // These never carry or borrow between counters as long as every result is in range
+    constexpr auto operator+(counts_t rhs) const -> counts_t { return counts_t{m_word + rhs.m_word}; }
+    constexpr auto operator-(counts_t rhs) const -> counts_t { return counts_t{m_word - rhs.m_word}; }
+    constexpr auto operator*(int scale) const -> counts_t { return counts_t{m_word * static_cast<std::uint64_t>(scale)}; }
+
+    // Each counter keeps its top bit through the subtraction only if it is at least rhs
+    constexpr auto at_least(counts_t rhs) const -> std::uint64_t
+    {
+        return ((m_word | high) - rhs.m_word) & high;
+    }
+
+    constexpr auto covers(counts_t rhs) const -> bool
+    {
+        return at_least(rhs) == high;
+    }
+
+    constexpr auto min(counts_t rhs) const -> counts_t
+    {
+        // Full 16-bit mask over every counter where rhs is the smaller
+        auto keep = (at_least(rhs) >> 15) * 0xFFFF;
+        return counts_t{(rhs.m_word & keep) | (m_word & ~keep)};
+    }
+
+    constexpr auto word() const -> std::uint64_t
+    {
+        return m_word;
+    }
+
+    // Whether every counter fits in the given number of bits
+    constexpr auto fits(int bits) const -> bool
+    {
+        auto above = ((0xFFFFull << bits) & 0xFFFF) * lanes;
+        return (m_word & above) == 0;
+    }
+
+    // The first few counters, squeezed down to a few bits each
+    template<int bits, int counters>
+    constexpr auto squeeze() const -> std::uint64_t
+    {
+        std::uint64_t key = 0;
+        for(int type = counters - 1; type >= 0; --type)
+            key = (key << bits) | static_cast<std::uint64_t>((*this)[type]);
+        return key;
+    }
+
+    static constexpr std::uint64_t lanes = 0x0001000100010001ull;
+    static constexpr std::uint64_t high = 0x8000800080008000ull;
+    static constexpr std::uint64_t minerals = 0x0000FFFFFFFFFFFFull;
+    static constexpr std::uint64_t unlimited_geodes = 0x7FFF000000000000ull;
+
+private:
+    std::uint64_t m_word;
+};
+
+// Everything a single search for the most geodes keeps track of, so that each
+// blueprint can be searched independently of the others. One search answers several
+// horizons at once, by recording the best geode count at the end of each of those turns.
+struct search_t
+{
+    explicit search_t(std::vector<std::size_t> horizons = {24})
+    : horizons{std::move(horizons)}
+    {
+        std::sort(this->horizons.begin(), this->horizons.end());
+        best.resize(this->horizons.back() + 1, 0);
+    }
+
+    // The longest horizon, which bounds the whole search
+    auto horizon() const -> std::size_t
+    {
+        return best.size() - 1;
+    }
+
+    void print() const
+    {
+        std::cout << expanded << " nodes expanded, " << pruned_bound << " cut by bound, "
+                  << pruned_seen << " cut by transposition table, took " << took.count() << "us" << std::endl;
+    }
+
+    std::vector<std::size_t> horizons;
+
+    // Best geode count found so far for each horizon, indexed by turn, and the most
+    // geodes seen on reaching each (turn, robots, minerals)
+    std::vector<int> best;
+    std::unordered_map<std::uint64_t, int> seen;
+
+    std::size_t expanded = 0;
+    std::size_t pruned_bound = 0;
+    std::size_t pruned_seen = 0;
+    std::chrono::microseconds took{};
+};
+
 struct blueprint_t
 {
 public:
@@ -17,7 +142,9 @@ public:
                 costs_t robot_cost_obsidian,
                 costs_t robot_cost_geode)
     : m_costs{robot_cost_ore, robot_cost_clay, robot_cost_obsidian, robot_cost_geode},
-      m_max_robots{max_robots(m_costs)}
+      m_max_robots{max_robots(m_costs)},
+      m_packed_costs{counts_t::from(robot_cost_ore), counts_t::from(robot_cost_clay), counts_t::from(robot_cost_obsidian), counts_t::from(robot_cost_geode)},
+      m_packed_max_robots{counts_t::from({m_max_robots[0], m_max_robots[1], m_max_robots[2], 0})}
     /*m_cost_ore{robot_cost_ore},
       m_cost_clay{robot_cost_clay},
       m_cost_obsidian{robot_cost_clay},
@@ -39,29 +166,32 @@ public:
             }
             std::cout << std::endl;
         }*/
-
-        m_previous_best.fill(0);
     }
 
-    auto max_geodes(std::size_t turn = 0) const -> std::size_t;
+    auto max_geodes(search_t & search) const -> void;
 
 private:
-    using state_t = std::pair<costs_t, costs_t>;
+    // Robots and minerals
+    using state_t = std::pair<counts_t, counts_t>;
 
     static auto print(state_t const & state) -> std::string;
 
-    static constexpr costs_t starting_robots{1,0,0,0};
-    static constexpr costs_t starting_minerals{0,0,0,0};
+    static constexpr counts_t starting_robots{counts_t::from({1,0,0,0})};
+    static constexpr counts_t starting_minerals{counts_t::from({0,0,0,0})};
     static constexpr state_t starting_state{std::make_pair(starting_robots, starting_minerals)};
 
     static auto max_robots(const std::array<costs_t, 4> costs) -> costs_t;
-    auto max_geodes_p(std::size_t turn, state_t state) const -> std::size_t;
-    auto build_robot(std::size_t turn, state_t state, int type) const -> std::size_t;
-    auto enough_minerals(const costs_t cost, state_t const & state) const -> bool;
+    static auto pack(std::size_t turn, state_t const & state) -> std::uint64_t;
+    auto max_geodes_p(search_t & search, std::size_t turn, state_t state) const -> void;
+    auto build_robot(search_t & search, std::size_t turn, state_t state, int type) const -> void;
+    auto discard_surplus(std::size_t remaining, state_t & state) const -> void;
 
     const std::array<costs_t, 4> m_costs;
     const costs_t m_max_robots;
-    mutable std::array<int, 33> m_previous_best;
+
+    // Same again, packed for the search
+    const std::array<counts_t, 4> m_packed_costs;
+    const counts_t m_packed_max_robots;
 
     /*const costs_t m_cost_ore;
     const costs_t m_cost_clay;
@@ -101,91 +231,154 @@ auto blueprint_t::max_robots(const std::array<costs_t, 4> costs) -> costs_t
     return max_each_robot;
 }
 
-auto blueprint_t::max_geodes(std::size_t turn) const -> std::size_t
+// Pack the state, bar the geodes themselves, into a transposition table key
+auto blueprint_t::pack(std::size_t turn, state_t const & state) -> std::uint64_t
 {
-    return max_geodes_p(turn, starting_state);
+    auto minerals = counts_t{state.second.word() & counts_t::minerals};
+
+    if(!state.first.fits(6) || !minerals.fits(11))
+    {
+        std::cout << "State too large to pack: " << print(state) << std::endl;
+        throw 5;
+    }
+
+    return (((turn << 24) | state.first.squeeze<6, 4>()) << 33) | minerals.squeeze<11, 3>();
 }
 
-auto blueprint_t::max_geodes_p(std::size_t turn, state_t state) const -> std::size_t
+auto blueprint_t::max_geodes(search_t & search) const -> void
 {
-    // Spend for robots has to be upfront, before earnings this round
-    std::array<bool, 4> affordable;
-    for(int type = 3; type >= 0; --type)
-        affordable[type] = enough_minerals(m_costs[type], state);
+    if(search.horizon() >= 64)
+    {
+        std::cout << "Horizon of " << search.horizon() << " is too long to search" << std::endl;
+        throw 5;
+    }
 
-    // All robots get more minerals
-    for(int i = 0; i < 4; ++i)
-        state.second[i] += state.first[i];
-    ++turn;
+    auto start = std::chrono::steady_clock::now();
+
+    max_geodes_p(search, 0, starting_state);
+
+    search.took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
 
-    auto & geodes = state.second.back();
+// Minerals beyond what could possibly be spent before the end make no difference, so
+// throw them away, which lets many more states match in the transposition table
+auto blueprint_t::discard_surplus(std::size_t remaining, state_t & state) const -> void
+{
+    auto left = static_cast<int>(remaining);
+
+    // Geodes are never spent, so leave them be
+    auto robots = counts_t{state.first.word() & counts_t::minerals};
+    auto spendable = m_packed_max_robots * left - robots * (left - 1);
+
+    state.second = state.second.min(counts_t{spendable.word() | counts_t::unlimited_geodes});
+}
+
+auto blueprint_t::max_geodes_p(search_t & search, std::size_t turn, state_t state) const -> void
+{
+    auto & robots = state.first;
+    auto & minerals = state.second;
+    bool promising = false;
+
+    for(auto horizon : search.horizons)
+    {
+        // Anything up to this turn was recorded on the way here
+        if(horizon < turn)
+            continue;
+
+        // What we end up with if we never build anything else
+        auto remaining = static_cast<int>(horizon - turn);
+        auto idle = minerals[3] + robots[3] * remaining;
+        auto & best = search.best[horizon];
+        best = std::max(best, idle);
+
+        // Unless building a geode robot every remaining turn could beat the best, this horizon has nothing left to find
+        promising = promising || idle + remaining * (remaining - 1) / 2 > best;
+    }
 
-    // If we don't have even half of the best we've managed by this point, abandon
-    if(turn < m_previous_best.size())
+    if(!promising)
     {
-        auto & prev = m_previous_best[turn];
-        if(geodes > prev)
+        ++search.pruned_bound;
+        return;
+    }
+
+    // Anything unspendable by the longest horizon is also unspendable by the others
+    discard_surplus(search.horizon() - turn, state);
+
+    // Been here before with at least as many geodes, so nothing new to find
+    auto [seen, inserted] = search.seen.try_emplace(pack(turn, state), minerals[3]);
+    if(!inserted)
+    {
+        if(seen->second >= minerals[3])
         {
-            //std::cout << "New record for most geodes: " << geodes << " (previous was " << prev << ") with turn = " << turn << " state = " << print(state) << std::endl;
-            prev = geodes;
+            ++search.pruned_seen;
+            return;
         }
-        auto minimum = prev / 2;
-        if(geodes < minimum)
-            return 0;
+        seen->second = minerals[3];
     }
 
-    if(turn == num_rounds)
-        return geodes;
-    
-    std::size_t best = 0;
+    ++search.expanded;
 
+    // Rather than idling a turn at a time, skip straight to building each type of robot next
     for(int type = 3; type >= 0; --type)
-        // Only make a robot of this type if we've not hit the sensible limit yet and we can afford to
-        if(state.first[type] < m_max_robots[type] && affordable[type])
-            best = std::max(best, build_robot(turn, state, type));
-
-    // Always consider doing nothing for a turn
-    return std::max(best, max_geodes_p(turn, state));
+        // Only make a robot of this type if we've not hit the sensible limit yet
+        if(robots[type] < m_max_robots[type])
+            build_robot(search, turn, state, type);
 }
 
-auto blueprint_t::build_robot(std::size_t turn, state_t state, int type) const -> std::size_t
+auto blueprint_t::build_robot(search_t & search, std::size_t turn, state_t state, int type) const -> void
 {
-    ++state.first[type];
-    for(int i = 0; i < 4; ++i)
-    {
-        state.second[i] -= m_costs[type][i];
+    auto & robots = state.first;
+    auto & minerals = state.second;
+    auto cost = m_packed_costs[type];
 
-        if(state.second[i] < 0)
+    // Wait until we can afford it, if we're making everything it needs
+    int wait = 0;
+    if(!minerals.covers(cost))
+    {
+        for(int i = 0; i < 3; ++i)
         {
-            std::cout << "Built a robot and ended up with negative quantity of type " << i << std::endl;
-            throw 5;
+            auto short_by = cost[i] - minerals[i];
+            if(short_by <= 0)
+                continue;
+            if(robots[i] == 0)
+                return;
+            wait = std::max(wait, (short_by + robots[i] - 1) / robots[i]);
         }
     }
 
+    // A geode robot needs a turn left to dig anything, and anything else needs time for
+    // its produce to be turned into a geode robot which then gets to dig
+    auto left = static_cast<int>(search.horizon() - turn) - wait - 1;
+    if(left < (type == 3 ? 1 : 3))
+        return;
+
+    minerals = minerals + robots * (wait + 1);
+
+    if(!minerals.covers(cost))
+    {
+        std::cout << "Built a robot of type " << type << " without enough minerals" << std::endl;
+        throw 5;
+    }
+
+    minerals = minerals - cost;
+    robots = robots.add(type, 1);
+
     //if(type == 2)
         //std::cout << "Built robot of type " << type << " turn = " << turn << " state = " << print(state) << std::endl;
 
-    return max_geodes_p(turn, state);
-}
-
-auto blueprint_t::enough_minerals(const costs_t cost, state_t const & state) const -> bool
-{
-    bool enough = true;
-    for(int i = 0; i < 4; ++i)
-        enough = enough && state.second[i] >= cost[i];
-    return enough;
+    max_geodes_p(search, turn + wait + 1, state);
 }
 
 using blueprint_vector = std::vector<blueprint_t>;
 
-auto parse_blueprints() -> blueprint_vector
+auto parse_blueprints(std::istream & in = std::cin) -> blueprint_vector
 {
     blueprint_vector ret;
     std::string line;
     std::smatch match;
     std::regex regex{"Blueprint ([0-9]+): Each ore robot costs ([0-9]+) ore. Each clay robot costs ([0-9]+) ore. Each obsidian robot costs ([0-9]+) ore and ([0-9]+) clay. Each geode robot costs ([0-9]+) ore and ([0-9]+) obsidian."};
 
-    while(std::getline(std::cin, line))
+    while(std::getline(in, line))
     {
         if(!std::regex_match(line, match, regex))
         {
@@ -203,42 +396,131 @@ auto parse_blueprints() -> blueprint_vector
     return ret;
 }
 
-auto part1(blueprint_vector const & blueprints) -> std::size_t
+// Call f with each index from 0 to count on a pool of threads, each taking the next index as it finishes
+template<typename F>
+void parallel_for(std::size_t count, std::size_t threads, F && f)
 {
-    std::size_t best = 0;
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
 
-    for(int i = 0; i < blueprints.size(); ++i)
+    for(std::size_t t = 0; t < std::max<std::size_t>(threads, 1); ++t)
     {
-        auto res = blueprints[i].max_geodes();
+        workers.emplace_back([&next, count, &f]
+        {
+            for(auto i = next++; i < count; i = next++)
+                f(i);
+        });
+    }
 
-        best += res * (i+1);
+    std::for_each(workers.begin(), workers.end(), [](auto & worker){ worker.join(); });
+}
 
-        std::cout << "Blueprint " << i << " managed a record of " << res << std::endl;
+static constexpr std::size_t part1_horizon = 24;
+static constexpr std::size_t part2_horizon = 32;
+static constexpr std::size_t part2_blueprints = 3;
+
+// Search every blueprint concurrently, each for its own set of horizons, returning each search in blueprint order
+template<typename F>
+auto search_blueprints(blueprint_vector const & blueprints, std::size_t threads, F && horizons) -> std::vector<search_t>
+{
+    std::vector<search_t> searches;
+    for(std::size_t i = 0; i < blueprints.size(); ++i)
+        searches.emplace_back(horizons(i));
+
+    parallel_for(blueprints.size(), threads, [&blueprints, &searches](std::size_t i)
+    {
+        blueprints[i].max_geodes(searches[i]);
+    });
+
+    return searches;
+}
+
+auto report(std::size_t i, std::size_t horizon, search_t const & search, bool stats) -> void
+{
+    std::cout << "Blueprint " << i << " managed a record of " << search.best.at(horizon) << " in " << horizon << " turns" << std::endl;
+
+    if(stats)
+        search.print();
+}
+
+auto part1(std::vector<search_t> const & searches, bool stats) -> std::size_t
+{
+    std::size_t best = 0;
+
+    for(std::size_t i = 0; i < searches.size(); ++i)
+    {
+        best += searches[i].best.at(part1_horizon) * (i+1);
+
+        report(i, part1_horizon, searches[i], stats);
     }
 
     return best;
 }
 
-auto part2(blueprint_vector const & blueprints) -> std::size_t
+auto part2(std::vector<search_t> const & searches) -> std::size_t
 {
     std::size_t product = 1;
-    num_rounds = 32;
 
-    for(int i = 0; i < 3; ++i)
+    for(std::size_t i = 0; i < std::min(part2_blueprints, searches.size()); ++i)
     {
-        auto res = blueprints[i].max_geodes();
-        product *= res;
-        std::cout << "Blueprint " << i << " managed a record of " << res << std::endl;
+        product *= searches[i].best.at(part2_horizon);
+
+        report(i, part2_horizon, searches[i], false);
     }
 
     return product;
 }
 
-int main()
+// Search a fixed set of blueprints on one thread, reporting nodes expanded per second
+auto bench(std::size_t repeats) -> void
+{
+    std::istringstream in{
+        "Blueprint 1: Each ore robot costs 4 ore. Each clay robot costs 2 ore. Each obsidian robot costs 3 ore and 14 clay. Each geode robot costs 2 ore and 7 obsidian.\n"
+        "Blueprint 2: Each ore robot costs 2 ore. Each clay robot costs 3 ore. Each obsidian robot costs 3 ore and 8 clay. Each geode robot costs 3 ore and 12 obsidian.\n"
+        "Blueprint 3: Each ore robot costs 4 ore. Each clay robot costs 4 ore. Each obsidian robot costs 2 ore and 11 clay. Each geode robot costs 3 ore and 8 obsidian.\n"
+        "Blueprint 4: Each ore robot costs 3 ore. Each clay robot costs 4 ore. Each obsidian robot costs 4 ore and 18 clay. Each geode robot costs 3 ore and 13 obsidian.\n"
+        "Blueprint 5: Each ore robot costs 2 ore. Each clay robot costs 2 ore. Each obsidian robot costs 2 ore and 17 clay. Each geode robot costs 2 ore and 10 obsidian.\n"};
+    auto blueprints = parse_blueprints(in);
+
+    std::size_t nodes = 0;
+    std::chrono::microseconds took{};
+
+    for(std::size_t repeat = 0; repeat < repeats; ++repeat)
+    {
+        for(auto const & blueprint : blueprints)
+        {
+            search_t search{{part2_horizon}};
+            blueprint.max_geodes(search);
+            nodes += search.expanded + search.pruned_bound + search.pruned_seen;
+            took += search.took;
+        }
+    }
+
+    std::cout << nodes << " nodes in " << took.count() << "us, "
+              << (nodes * 1000000.0 / took.count()) << " nodes/s" << std::endl;
+}
+
+// Usage: main [threads] [stats], or main bench [repeats]
+int main(int argc, char * argv[])
 {
+    if(argc > 1 && std::string{argv[1]} == "bench")
+    {
+        bench(argc > 2 ? std::stoul(argv[2]) : 10);
+        return 0;
+    }
+
+    std::size_t threads = argc > 1 ? std::stoul(argv[1]) : std::thread::hardware_concurrency();
+    bool stats = argc > 2 && std::string{argv[2]} == "stats";
+
     auto blueprints = parse_blueprints();
 
-    std::cout << part1(blueprints) << std::endl;
-    std::cout << part2(blueprints) << std::endl;
+    // The first few blueprints answer both parts in a single search
+    auto searches = search_blueprints(blueprints, threads, [](std::size_t i)
+    {
+        return i < part2_blueprints ? std::vector<std::size_t>{part1_horizon, part2_horizon} : std::vector<std::size_t>{part1_horizon};
+    });
+
+    std::cout << part1(searches, stats) << std::endl;
+    std::cout << part2(searches) << std::endl;
     return 0;
-}
\ No newline at end of file
+}
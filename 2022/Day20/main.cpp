@@ -1,5 +1,12 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
 struct element_t
@@ -73,7 +80,8 @@ void mix(elements_t & values)
         }
         else
         {
-            // Walk backwards
+            // Walk backwards, from the value's old neighbour as it's no longer in the list
+            dest = current.next;
             auto newdist = (0-current.value) % modulo;
             for(int64_t j = 0; j < newdist; ++j)
                 dest = values.at(dest).prev;
@@ -95,6 +103,18 @@ void mix(elements_t & values)
     }
 }
 
+// The values in list order, starting from zero
+auto sequence(elements_t const & values) -> std::vector<int64_t>
+{
+    auto index = static_cast<std::size_t>(std::find_if(values.begin(), values.end(), [](auto & e) { return e.value == 0; }) - values.begin());
+    std::vector<int64_t> ret;
+
+    for(auto i = index; ret.size() < values.size(); i = values.at(i).next)
+        ret.push_back(values.at(i).value);
+
+    return ret;
+}
+
 auto coordinates(elements_t const & values) -> int64_t
 {
     // Linear search, find the index of the starting value zero
@@ -129,10 +149,486 @@ auto coordinates(elements_t const & values) -> int64_t
 }
 
 
-int main()
+// The linked list with extra links from every element to the ones stride places ahead and
+// behind it, so a walk is mostly big hops followed by at most stride single steps. Moving an
+// element only shifts the skip links which jumped over the place it left or lands in, which
+// are those of the stride elements either side, so each move is O(n / stride + stride) and
+// a stride of sqrt(n) balances the two.
+class skip_list_t
+{
+public:
+    explicit skip_list_t(elements_t values)
+    : m_values{std::move(values)},
+      m_ahead(m_values.size()),
+      m_behind(m_values.size()),
+      m_stride{std::max<std::size_t>(1, static_cast<std::size_t>(std::sqrt(m_values.size())))}
+    {
+        // Follow the list rather than assume it's in index order, with both ends of each
+        // link stepping along it together
+        for(std::size_t count = 0, i = 0, ahead = walk_next(0, m_stride); count < size(); ++count)
+        {
+            m_ahead[i] = ahead;
+            m_behind[ahead] = i;
+            i = m_values[i].next;
+            ahead = m_values[ahead].next;
+        }
+    }
+
+    auto size() const -> std::size_t
+    {
+        return m_values.size();
+    }
+
+    auto values() const -> elements_t const &
+    {
+        return m_values;
+    }
+
+    // Where we end up from the element at index after the given number of steps, going
+    // whichever way round the list is shorter
+    auto walk(std::size_t index, std::size_t steps, std::size_t length) const -> std::size_t
+    {
+        steps %= length;
+        if(steps <= length / 2)
+            return walk(index, steps, m_ahead, &element_t::next);
+        return walk(index, length - steps, m_behind, &element_t::prev);
+    }
+
+    // Take an element out of the list, leaving its own links as they were
+    void unlink(std::size_t index)
+    {
+        auto & current = m_values[index];
+        m_values[current.prev].next = current.next;
+        m_values[current.next].prev = current.prev;
+
+        // The skip links which jumped over it now fall one short
+        for(std::size_t i = 0, before = current.prev; i < m_stride; ++i, before = m_values[before].prev)
+            m_ahead[before] = m_ahead[before] == index ? current.next : m_values[m_ahead[before]].next;
+        for(std::size_t i = 0, after = current.next; i < m_stride; ++i, after = m_values[after].next)
+            m_behind[after] = m_behind[after] == index ? current.prev : m_values[m_behind[after]].prev;
+    }
+
+    // Put an unlinked element back in after another
+    void link_after(std::size_t index, std::size_t prev)
+    {
+        auto & current = m_values[index];
+        current.prev = prev;
+        current.next = m_values[prev].next;
+        m_values[current.next].prev = index;
+        m_values[prev].next = index;
+
+        // The skip links which now jump over it go one too far
+        for(std::size_t i = 0, before = prev; i < m_stride; ++i, before = m_values[before].prev)
+            m_ahead[before] = m_values[m_ahead[before]].prev;
+        for(std::size_t i = 0, after = current.next; i < m_stride; ++i, after = m_values[after].next)
+            m_behind[after] = m_values[m_behind[after]].next;
+
+        // And its own go one further than its neighbours'
+        m_ahead[index] = m_values[m_ahead[prev]].next;
+        m_behind[index] = m_values[m_behind[current.next]].prev;
+    }
+
+private:
+    auto walk_next(std::size_t index, std::size_t steps) const -> std::size_t
+    {
+        for(; steps; --steps)
+            index = m_values[index].next;
+        return index;
+    }
+
+    auto walk(std::size_t index, std::size_t steps, std::vector<std::size_t> const & skip, std::size_t element_t::*step) const -> std::size_t
+    {
+        for(; steps >= m_stride; steps -= m_stride)
+            index = skip[index];
+        for(; steps; --steps)
+            index = m_values[index].*step;
+        return index;
+    }
+
+    elements_t m_values;
+    std::vector<std::size_t> m_ahead;
+    std::vector<std::size_t> m_behind;
+    std::size_t m_stride;
+};
+
+void mix(skip_list_t & list)
+{
+    // Moving past all the other elements gets back to the same place
+    auto modulo = static_cast<int64_t>(list.size() - 1);
+
+    for(std::size_t i = 0; i < list.size(); ++i)
+    {
+        auto & current = list.values()[i];
+        auto steps = (current.value % modulo + modulo) % modulo;
+
+        list.unlink(i);
+        list.link_after(i, list.walk(current.prev, static_cast<std::size_t>(steps), list.size() - 1));
+    }
+}
+
+auto sequence(skip_list_t const & list) -> std::vector<int64_t>
+{
+    return sequence(list.values());
+}
+
+auto coordinates(skip_list_t const & list) -> int64_t
 {
+    auto & values = list.values();
+    auto zero = static_cast<std::size_t>(std::find_if(values.begin(), values.end(), [](auto & e) { return e.value == 0; }) - values.begin());
+
+    int64_t res = 0;
+    for(std::size_t i = 1000; i <= 3000; i += 1000)
+        res += values[list.walk(zero, i, list.size())].value;
+
+    return res;
+}
+
+// An implicit treap over the elements, in mixed order. Positions aren't stored anywhere but
+// follow from subtree sizes, and nodes keep their original index, so finding where an element
+// is now, taking it out and putting it back elsewhere are all O(log n) instead of a walk
+// along the list.
+class treap_t
+{
+public:
+    explicit treap_t(elements_t const & values)
+    {
+        std::mt19937 gen(values.size());
+
+        m_nodes.reserve(values.size());
+        for(auto & value : values)
+        {
+            m_nodes.push_back(node_t{value.value, static_cast<uint32_t>(gen())});
+            m_root = merge(m_root, m_nodes.size() - 1);
+        }
+    }
+
+    auto size() const -> std::size_t
+    {
+        return m_nodes.size();
+    }
+
+    // Value of the element originally at this index
+    auto value(std::size_t node) const -> int64_t
+    {
+        return m_nodes[node].value;
+    }
+
+    // Where the element originally at this index is now
+    auto position(std::size_t node) const -> std::size_t
+    {
+        auto ret = size_of(m_nodes[node].left);
+
+        for(auto child = node, parent = m_nodes[node].parent; parent != none; child = parent, parent = m_nodes[parent].parent)
+        {
+            if(m_nodes[parent].right == child)
+                ret += size_of(m_nodes[parent].left) + 1;
+        }
+
+        return ret;
+    }
+
+    // Value of the element now at this position
+    auto at(std::size_t pos) const -> int64_t
+    {
+        auto node = m_root;
+
+        while(true)
+        {
+            auto left = size_of(m_nodes[node].left);
+            if(pos == left)
+                return m_nodes[node].value;
+
+            if(pos < left)
+            {
+                node = m_nodes[node].left;
+            }
+            else
+            {
+                pos -= left + 1;
+                node = m_nodes[node].right;
+            }
+        }
+    }
+
+    // Take the element out and put it back so it ends up at the given position among the rest
+    void move(std::size_t node, std::size_t pos)
+    {
+        auto [before, from] = split(m_root, position(node));
+        auto [single, after] = split(from, 1);
+        auto [left, right] = split(merge(before, after), pos);
+
+        m_root = merge(merge(left, single), right);
+        m_nodes[m_root].parent = none;
+    }
+
+private:
+    static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+    struct node_t
+    {
+        int64_t value;
+        uint32_t priority;
+        std::size_t left = none;
+        std::size_t right = none;
+        std::size_t parent = none;
+        std::size_t size = 1;
+    };
+
+    auto size_of(std::size_t node) const -> std::size_t
+    {
+        return node == none ? 0 : m_nodes[node].size;
+    }
+
+    void update(std::size_t node)
+    {
+        auto & n = m_nodes[node];
+        n.size = 1 + size_of(n.left) + size_of(n.right);
+
+        if(n.left != none)
+            m_nodes[n.left].parent = node;
+        if(n.right != none)
+            m_nodes[n.right].parent = node;
+    }
+
+    // Join two treaps, everything in the first coming before everything in the second
+    auto merge(std::size_t first, std::size_t second) -> std::size_t
+    {
+        if(first == none)
+            return second;
+        if(second == none)
+            return first;
+
+        if(m_nodes[first].priority > m_nodes[second].priority)
+        {
+            m_nodes[first].right = merge(m_nodes[first].right, second);
+            update(first);
+            return first;
+        }
+
+        m_nodes[second].left = merge(first, m_nodes[second].left);
+        update(second);
+        return second;
+    }
+
+    // Split a treap into its first count elements and the rest
+    auto split(std::size_t node, std::size_t count) -> std::pair<std::size_t, std::size_t>
+    {
+        if(node == none)
+            return {none, none};
+
+        auto & n = m_nodes[node];
+        if(size_of(n.left) >= count)
+        {
+            auto [left, right] = split(n.left, count);
+            n.left = right;
+            update(node);
+            return {left, node};
+        }
+
+        auto [left, right] = split(n.right, count - size_of(n.left) - 1);
+        n.right = left;
+        update(node);
+        return {node, right};
+    }
+
+    std::vector<node_t> m_nodes;
+    std::size_t m_root = none;
+};
+
+void mix(treap_t & treap)
+{
+    // Moving past all the other elements gets back to the same place
+    auto modulo = static_cast<int64_t>(treap.size() - 1);
+
+    for(std::size_t i = 0; i < treap.size(); ++i)
+    {
+        auto pos = static_cast<int64_t>(treap.position(i)) + treap.value(i) % modulo;
+        treap.move(i, static_cast<std::size_t>((pos % modulo + modulo) % modulo));
+    }
+}
+
+auto sequence(treap_t const & treap) -> std::vector<int64_t>
+{
+    std::size_t zero = 0;
+    while(treap.value(zero) != 0)
+        ++zero;
+
+    std::vector<int64_t> ret;
+    for(auto pos = treap.position(zero); ret.size() < treap.size(); pos = (pos + 1) % treap.size())
+        ret.push_back(treap.at(pos));
+
+    return ret;
+}
+
+auto coordinates(treap_t const & treap) -> int64_t
+{
+    std::size_t zero = 0;
+    while(treap.value(zero) != 0)
+        ++zero;
+
+    auto start = treap.position(zero);
+    int64_t res = 0;
+
+    for(std::size_t i = 1000; i <= 3000; i += 1000)
+        res += treap.at((start + i) % treap.size());
+
+    return res;
+}
+
+constexpr int64_t key = 811589153;
+constexpr int rounds = 10;
+
+auto decrypt(elements_t values) -> elements_t
+{
+    std::for_each(values.begin(), values.end(), [](auto & entry)
+    {
+        entry.value *= key;
+    });
+    return values;
+}
+
+// Mix with the treap, the skip list and the plain linked list, checking they all agree after
+// every round
+auto check(elements_t const & values, int count) -> bool
+{
+    auto list = values;
+    skip_list_t skip{values};
+    treap_t treap{values};
+
+    for(int i = 0; i < count; ++i)
+    {
+        mix(list);
+        mix(skip);
+        mix(treap);
+
+        auto expected = sequence(list);
+        if(sequence(skip) != expected || sequence(treap) != expected)
+        {
+            std::cout << "Mismatch after round " << i + 1 << " of " << values.size() << " values" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// A list of random values in input order, with a single zero somewhere
+auto random_values(std::size_t size, int64_t spread, std::mt19937 & gen) -> elements_t
+{
+    std::uniform_int_distribution<int64_t> dist(-spread, spread);
+
+    elements_t values;
+    for(std::size_t i = 0; i < size; ++i)
+        values.emplace_back(i == 0 ? 0 : dist(gen), i - 1, i + 1);
+    std::shuffle(values.begin(), values.end(), gen);
+
+    for(std::size_t i = 0; i < size; ++i)
+    {
+        values[i].prev = (i + size - 1) % size;
+        values[i].next = (i + 1) % size;
+    }
+    return values;
+}
+
+// The puzzle input, then random lists including the awkward small sizes and values which are
+// multiples of the list size
+auto check_all(elements_t const & orig) -> bool
+{
+    auto ok = check(orig, 1) && check(decrypt(orig), rounds);
+
+    std::mt19937 gen(20);
+    for(std::size_t trial = 0; ok && trial < 1000; ++trial)
+    {
+        auto size = std::uniform_int_distribution<std::size_t>(2, 40)(gen);
+        auto values = random_values(size, 3 * static_cast<int64_t>(size), gen);
+
+        ok = check(values, 1) && check(decrypt(values), 2);
+    }
+
+    std::cout << (ok ? "Treap and skip list match linked list" : "Treap or skip list differs from linked list") << std::endl;
+    return ok;
+}
+
+template<typename engine_t>
+auto rounds_per_second(elements_t const & values, int count) -> double
+{
+    engine_t engine{values};
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < count; ++i)
+        mix(engine);
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+    return count / took.count();
+}
+
+// Rounds of mixing per second for each engine on random decrypted lists of growing size. The
+// plain list is quadratic and the skip list n^1.5, so they sit out the bigger ones.
+void bench(int count)
+{
+    std::mt19937 gen(20);
+    std::cout << "size\tlist\tskip\ttreap" << std::endl;
+
+    for(std::size_t size : {1000, 5000, 20000, 100000, 1000000})
+    {
+        auto values = decrypt(random_values(size, 10000, gen));
+
+        std::cout << size << '\t';
+        if(size <= 20000)
+            std::cout << rounds_per_second<elements_t>(values, count);
+        else
+            std::cout << '-';
+
+        std::cout << '\t';
+        if(size <= 100000)
+            std::cout << rounds_per_second<skip_list_t>(values, count);
+        else
+            std::cout << '-';
+
+        std::cout << '\t' << rounds_per_second<treap_t>(values, count) << std::endl;
+    }
+}
+
+template<typename engine_t>
+void solve(elements_t const & orig)
+{
+    engine_t values{orig};
+    mix(values);
+    std::cout << coordinates(values) << std::endl;
+
+    engine_t part2{decrypt(orig)};
+    for(int i = 0; i < rounds; ++i)
+        mix(part2);
+    std::cout << coordinates(part2) << std::endl;
+}
+
+// Usage: main [treap|skip|list], main check (compare them all), or main bench [rounds]
+int main(int argc, char * argv[])
+{
+    auto mode = std::string{argc > 1 ? argv[1] : ""};
+
+    if(mode == "bench")
+    {
+        bench(argc > 2 ? std::stoi(argv[2]) : 1);
+        return 0;
+    }
+
     auto orig = parse();
 
+    if(mode == "check")
+        return check_all(orig) ? 0 : 1;
+
+    if(mode == "skip")
+    {
+        solve<skip_list_t>(orig);
+        return 0;
+    }
+
+    if(mode != "list")
+    {
+        solve<treap_t>(orig);
+        return 0;
+    }
+
     auto values = orig;
 
     std::cout << "Mixing" << std::endl;
@@ -141,16 +637,10 @@ int main()
 
     std::cout << coordinates(values) << std::endl;
 
-    auto part2 = orig;
-
-    std::for_each(part2.begin(), part2.end(), [](auto & entry)
-    {
-        entry.value *= 811589153;
-    });
-
+    auto part2 = decrypt(orig);
 
     //print(part2);
-    for(int i = 0; i < 10; ++i)
+    for(int i = 0; i < rounds; ++i)
     {
         std::cout << "Mixing" << std::endl;
         mix(part2);
@@ -1,8 +1,46 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <list>
 #include <map>
+#include <new>
+#include <numeric>
+#include <optional>
+#include <random>
 #include <set>
 #include <string>
+#include <thread>
+#include <vector>
+
+// Every allocation made through the global operator new, so rounds can be checked not to make any.
+// The bitgrid bands allocate from their own threads too, so the count has to be atomic.
+std::atomic<std::size_t> allocations = 0;
+
+void * operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(auto ret = std::malloc(size ? size : 1))
+        return ret;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void * ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
 
 using elf_t = std::pair<int64_t, int64_t>;
 using elves_t = std::set<elf_t>;
@@ -73,12 +111,13 @@ auto neighbours(elves_t const & elves, elf_t current, int dir) -> std::optional<
 
 static std::list<int> dirpirs = {0,1,2,3};
 
-auto propose(elves_t const & elves, elf_t current) -> elf_t
+// Sets alone if the elf has no neighbours at all
+auto propose(elves_t const & elves, elf_t current, bool & alone) -> elf_t
 {
     bool none = true;
     auto prop = current;
 
-    std::for_each(dirpirs.rbegin(), dirpirs.rend(), [elves, current, &none, &prop](auto dir)
+    std::for_each(dirpirs.rbegin(), dirpirs.rend(), [&elves, current, &none, &prop](auto dir)
     {
         auto res = neighbours(elves, current, dir);
         none = none && res;
@@ -86,6 +125,7 @@ auto propose(elves_t const & elves, elf_t current) -> elf_t
             prop = res.value();
     });
 
+    alone = none;
     if(none)
         return current;
     return prop;
@@ -93,13 +133,18 @@ auto propose(elves_t const & elves, elf_t current) -> elf_t
 
 using proposals_t = std::multimap<elf_t, elf_t>;
 
-auto proposals(elves_t const & elves) -> proposals_t
+// Proposals from just the active elves, any others being known to have no neighbours. Elves
+// found to have no neighbours either are left out too, unless asked for.
+auto proposals(elves_t const & elves, elves_t const & active, bool with_alone = false) -> proposals_t
 {
     proposals_t ret;
 
-    std::for_each(elves.begin(), elves.end(), [&ret, elves](auto elf)
+    std::for_each(active.begin(), active.end(), [&ret, &elves, with_alone](auto elf)
     {
-        auto dst = propose(elves, elf);
+        bool alone = false;
+        auto dst = propose(elves, elf, alone);
+        if(alone && !with_alone)
+            return;
         //std::cout << "Elf at " << elf.first << "," << elf.second << " proposing " << dst.first << "," << dst.second << std::endl;
         ret.insert(std::make_pair(dst, elf));
     });
@@ -112,11 +157,16 @@ auto proposals(elves_t const & elves) -> proposals_t
     return ret;
 }
 
+auto proposals(elves_t const & elves) -> proposals_t
+{
+    return proposals(elves, elves, true);
+}
+
 auto resolve(proposals_t const & props) -> elves_t
 {
     elves_t ret;
 
-    std::for_each(props.begin(), props.end(), [&ret, props](auto current)
+    std::for_each(props.begin(), props.end(), [&ret, &props](auto current)
     {
         elf_t dest = current.first;
 
@@ -144,10 +194,8 @@ auto resolve(proposals_t const & props) -> elves_t
 auto resolver(elves_t & elves, proposals_t const & props) -> std::size_t
 {
     std::size_t ret = 0;
-    std::for_each(props.begin(), props.end(), [&elves, &ret, props](auto current)
+    std::for_each(props.begin(), props.end(), [&elves, &ret, &props](auto current)
     {
-        elf_t dest = current.first;
-
         // Check if this proposed destination is unique
         if(props.count(current.first) == 1 && current.first != current.second)
         {
@@ -219,30 +267,692 @@ auto part1(elves_t elves) -> std::size_t
     
 }
 
-auto part2(elves_t elves) -> std::size_t
+// Calls fn for each of the eight cells around the elf
+template<typename fn_t>
+void around(elf_t elf, fn_t fn)
+{
+    for(auto row = elf.first - 1; row <= elf.first + 1; ++row)
+        for(auto col = elf.second - 1; col <= elf.second + 1; ++col)
+            if(row != elf.first || col != elf.second)
+                fn(elf_t{row, col});
+}
+
+// The elves which might move next round, given this round's proposals from those that had
+// neighbours. An elf with no neighbours stays put, and goes on having none until an elf moves
+// next to it, so only those which had neighbours already and those an elf just moved next to
+// need looking at again. Elves next to where one moved from had it as a neighbour, so they're
+// in the first lot.
+auto frontier(elves_t const & elves, proposals_t const & props) -> elves_t
+{
+    elves_t ret;
+
+    std::for_each(props.begin(), props.end(), [&ret, &elves](auto const & current)
+    {
+        auto [dest, src] = current;
+
+        // Nobody else could have moved into a cell which was occupied
+        if(dest != src && !elves.contains(src))
+        {
+            ret.insert(dest);
+            around(dest, [&ret, &elves](auto elf) { if(elves.contains(elf)) ret.insert(elf); });
+            return;
+        }
+
+        ret.insert(src);
+    });
+
+    return ret;
+}
+
+// With stats, reports how many allocations the first round made, and the most any later one did
+auto part2(elves_t elves, bool stats = false) -> std::size_t
 {
-    int round = 0;
+    // Start over with north first, rather than carry on from wherever part 1 left off
+    dirpirs = {0, 1, 2, 3};
+
+    // Every elf might move in the first round
+    auto active = elves;
+    std::size_t round = 1, first = 0, most = 0;
+
     while(true)
     {
+        //std::cout << "Round " << round << " with " << active.size() << " of " << elves.size() << " active" << std::endl;
+        auto before = allocations;
+        auto props = proposals(elves, active);
+        auto moved = resolver(elves, props);
+
+        if(moved)
+            active = frontier(elves, props);
+
+        (round == 1 ? first : most) = std::max(round == 1 ? first : most, allocations - before);
+        if(!moved)
+            break;
         ++round;
-        std::cout << "Round " << round << " with " << elves.size() << std::endl;
-        auto props = proposals(elves);
-        //std::cout << "Proposals " << props.size() << std::endl;
-        auto newelves = resolve(props);
-        
-        if(newelves == elves)
+    }
+
+    if(stats)
+        std::cout << "Allocations: " << first << " in the first round, at most " << most << " in the other " << round - 1 << std::endl;
+
+    return round;
+}
+
+// The elves as one bit per cell, 64 columns to a word with bit b of word w being column
+// 64w + b, so a whole word of elves looks at its neighbours and picks a direction with a few
+// shifts and masks. Two elves can only propose the same cell from opposite sides: one coming
+// from the side would have had to see the other as a neighbour, so it wouldn't have picked that
+// way. So clashes are just north against south and west against east.
+//
+// Only the rows and words any elf has reached are worked on. There's a spare row above and
+// below the grid and the grid grows before an elf can get within two rows or a word of its
+// edge, so no elf ever walks off it.
+//
+// Each round is split into horizontal bands, one per thread. Every row's proposals depend only
+// on the cells around it, and every row's next state is gathered from the proposals around it
+// rather than scattered, so bands only meet at a barrier between the two halves of the round
+// and the result is the same whatever the number of threads.
+class bitgrid_t
+{
+public:
+    explicit bitgrid_t(elves_t const & elves, std::size_t threads = 1)
+    : m_bands(std::max<std::size_t>(threads, 1)),
+      m_sync(static_cast<std::ptrdiff_t>(m_bands.size()))
+    {
+        int64_t min_row = std::numeric_limits<int64_t>::max(), max_row = std::numeric_limits<int64_t>::min();
+        int64_t min_col = std::numeric_limits<int64_t>::max(), max_col = std::numeric_limits<int64_t>::min();
+
+        std::for_each(elves.begin(), elves.end(), [&](auto const & elf)
+        {
+            min_row = std::min(min_row, elf.first);
+            max_row = std::max(max_row, elf.first);
+            min_col = std::min(min_col, elf.second);
+            max_col = std::max(max_col, elf.second);
+        });
+
+        // Leave about as much room again either side of the elves as they take up to start with
+        auto height = static_cast<std::size_t>(max_row - min_row + 1);
+        auto width = static_cast<std::size_t>(max_col - min_col + 1);
+
+        m_rows = 3 * height;
+        m_words = (3 * width + 63) / 64 + 2;
+        allocate();
+
+        m_top = height;
+        m_bottom = 2 * height - 1;
+        m_first_word = (m_words * 64 - width) / 2 / 64;
+        m_last_word = ((m_words * 64 - width) / 2 + width - 1) / 64;
+
+        std::for_each(elves.begin(), elves.end(), [&](auto const & elf)
         {
-            return round + 1;
+            auto col = static_cast<std::size_t>(elf.second - min_col) + (m_words * 64 - width) / 2;
+            row(m_cells, static_cast<std::size_t>(elf.first - min_row) + m_top)[col / 64] |= uint64_t{1} << (col % 64);
+        });
+
+        for(std::size_t band = 1; band < m_bands.size(); ++band)
+            m_workers.emplace_back([this, band] { work(band); });
+    }
+
+    bitgrid_t(bitgrid_t const &) = delete;
+    auto operator=(bitgrid_t const &) -> bitgrid_t & = delete;
+
+    ~bitgrid_t()
+    {
+        m_stop = true;
+        if(!m_workers.empty())
+            m_sync.arrive_and_wait();
+    }
+
+    // Run a round, returning how many elves moved
+    auto round() -> std::size_t
+    {
+        if(m_top < 2 || m_bottom + 2 >= m_rows)
+            grow(true, false);
+        if(m_first_word == 0 || m_last_word + 1 == m_words)
+            grow(false, true);
+
+        // Elves can arrive a row above or below the rows they're in now
+        auto rows = m_bottom + 3 - m_top;
+        for(std::size_t band = 0; band < m_bands.size(); ++band)
+        {
+            m_bands[band].first = m_top - 1 + rows * band / m_bands.size();
+            m_bands[band].last = m_top - 1 + rows * (band + 1) / m_bands.size();
         }
 
-        elves = newelves;
+        if(m_workers.empty())
+        {
+            propose(m_bands.front());
+            settle(m_bands.front());
+        }
+        else
+        {
+            m_sync.arrive_and_wait();
+            propose(m_bands.front());
+            m_sync.arrive_and_wait();
+            settle(m_bands.front());
+            m_sync.arrive_and_wait();
+        }
+
+        // Anything arriving outside the rows and words we've worked on so far widens them
+        std::size_t moved = 0;
+        bool first_word = false, last_word = false;
+
+        for(auto & band : m_bands)
+        {
+            moved += band.moved;
+            m_top = std::min(m_top, band.top);
+            m_bottom = std::max(m_bottom, band.bottom);
+            first_word = first_word || band.first_word;
+            last_word = last_word || band.last_word;
+        }
+
+        m_first_word -= first_word ? 1 : 0;
+        m_last_word += last_word ? 1 : 0;
+
+        std::swap(m_cells, m_next);
+        m_first = (m_first + 1) % 4;
+
+        return moved;
+    }
+
+    // Empty cells in the smallest rectangle holding all the elves
+    auto empty_ground() const -> std::size_t
+    {
+        std::size_t elves = 0, first_row = m_rows, last_row = 0;
+        std::vector<uint64_t> columns(m_words, 0);
+
+        for(std::size_t r = 0; r < m_rows; ++r)
+        {
+            auto cells = row(m_cells, r);
+            for(std::size_t w = 0; w < m_words; ++w)
+            {
+                if(cells[w])
+                {
+                    first_row = std::min(first_row, r);
+                    last_row = r;
+                }
+                columns[w] |= cells[w];
+                elves += static_cast<std::size_t>(std::popcount(cells[w]));
+            }
+        }
+
+        auto first_word = static_cast<std::size_t>(std::find_if(columns.begin(), columns.end(), [](auto c) { return c != 0; }) - columns.begin());
+        auto last_word = static_cast<std::size_t>(std::find_if(columns.rbegin(), columns.rend(), [](auto c) { return c != 0; }).base() - columns.begin()) - 1;
+
+        auto first_col = first_word * 64 + static_cast<std::size_t>(std::countr_zero(columns[first_word]));
+        auto last_col = last_word * 64 + 63 - static_cast<std::size_t>(std::countl_zero(columns[last_word]));
+
+        return (last_row + 1 - first_row) * (last_col + 1 - first_col) - elves;
     }
 
+private:
+    using cells_t = std::vector<uint64_t>;
+
+    // A range of rows to work on, and what happened in them
+    struct band_t
+    {
+        std::size_t first = 0;
+        std::size_t last = 0;       // One past
+        std::size_t moved = 0;
+        std::size_t top = 0;
+        std::size_t bottom = 0;
+        bool first_word = false;
+        bool last_word = false;
+    };
+
+    void work(std::size_t band)
+    {
+        while(true)
+        {
+            m_sync.arrive_and_wait();
+            if(m_stop)
+                return;
+
+            propose(m_bands[band]);
+            m_sync.arrive_and_wait();
+            settle(m_bands[band]);
+            m_sync.arrive_and_wait();
+        }
+    }
+
+    // Each elf proposes the first direction in this round's order with nothing there
+    void propose(band_t const & band)
+    {
+        for(auto r = std::max(band.first, m_top); r < band.last && r <= m_bottom; ++r)
+        {
+            auto above = row(m_cells, r - 1);
+            auto here = row(m_cells, r);
+            auto below = row(m_cells, r + 1);
+
+            for(auto w = m_first_word; w <= m_last_word; ++w)
+            {
+                auto west = shift_east(above, w) | shift_east(here, w) | shift_east(below, w);
+                auto east = shift_west(above, w) | shift_west(here, w) | shift_west(below, w);
+
+                std::array<uint64_t, 4> free{~(shift_east(above, w) | above[w] | shift_west(above, w)),
+                                             ~(shift_east(below, w) | below[w] | shift_west(below, w)),
+                                             ~west,
+                                             ~east};
+
+                // Elves with no neighbours at all stay put
+                auto alone = free[0] & free[1] & free[2] & free[3];
+                auto left = here[w] & ~alone;
+
+                for(int i = 0; i < 4; ++i)
+                {
+                    auto dir = (m_first + i) % 4;
+                    row(m_proposals[dir], r)[w] = left & free[dir];
+                    left &= ~free[dir];
+                }
+
+                // As do those with nowhere to go
+                row(m_next, r)[w] = (here[w] & alone) | left;
+            }
+        }
+    }
+
+    // Move elves into the cells proposed once. Those proposing a cell that was also proposed
+    // from the opposite side, two rows or columns away, stay where they are.
+    void settle(band_t & band)
+    {
+        band.moved = 0;
+        band.top = m_top;
+        band.bottom = m_bottom;
+        band.first_word = false;
+        band.last_word = false;
+
+        for(auto r = band.first; r < band.last; ++r)
+        {
+            auto north = row(m_proposals[0], r);
+            auto south = row(m_proposals[1], r);
+            auto west = row(m_proposals[2], r);
+            auto east = row(m_proposals[3], r);
+            auto from_south = row(m_proposals[0], r + 1);
+            auto from_north = row(m_proposals[1], r - 1);
+            auto next = row(m_next, r);
+            uint64_t any = 0;
+
+            for(auto w = m_first_word - 1; w <= m_last_word + 1; ++w)
+            {
+                auto from_east = shift_west(west, w);
+                auto from_west = shift_east(east, w);
+
+                auto arrived = (from_south[w] ^ from_north[w]) | (from_east ^ from_west);
+                auto bounced = (north[w] & row(m_proposals[1], r - 2)[w]) |
+                               (south[w] & row(m_proposals[0], r + 2)[w]) |
+                               (west[w] & shift_east(east, w, 2)) |
+                               (east[w] & shift_west(west, w, 2));
+
+                next[w] |= arrived | bounced;
+                band.moved += static_cast<std::size_t>(std::popcount(arrived));
+                any |= arrived;
+            }
+
+            if(any)
+            {
+                band.top = std::min(band.top, r);
+                band.bottom = std::max(band.bottom, r);
+            }
+            band.first_word = band.first_word || next[m_first_word - 1];
+            band.last_word = band.last_word || next[m_last_word + 1];
+        }
+    }
+
+    // Rows are stored one down, past the spare row at the top
+    auto row(cells_t & cells, std::size_t r) const -> uint64_t *
+    {
+        return cells.data() + (r + 1) * m_words;
+    }
+
+    auto row(cells_t const & cells, std::size_t r) const -> uint64_t const *
+    {
+        return cells.data() + (r + 1) * m_words;
+    }
+
+    // Each cell moved one or two columns east or west, carrying across words
+    auto shift_east(uint64_t const * cells, std::size_t w, int by = 1) const -> uint64_t
+    {
+        return (cells[w] << by) | (w ? cells[w - 1] >> (64 - by) : 0);
+    }
+
+    auto shift_west(uint64_t const * cells, std::size_t w, int by = 1) const -> uint64_t
+    {
+        return (cells[w] >> by) | (w + 1 < m_words ? cells[w + 1] << (64 - by) : 0);
+    }
+
+    void allocate()
+    {
+        auto size = (m_rows + 2) * m_words;
+
+        m_cells.assign(size, 0);
+        m_next.assign(size, 0);
+        for(auto & proposals : m_proposals)
+            proposals.assign(size, 0);
+    }
+
+    // Double the height or width of the grid, keeping the elves in the middle
+    void grow(bool rows, bool words)
+    {
+        auto old = std::move(m_cells);
+        auto old_words = m_words;
+        auto row_offset = rows ? m_rows / 2 : 0;
+        auto word_offset = words ? m_words / 2 : 0;
+
+        m_rows *= rows ? 2 : 1;
+        m_words *= words ? 2 : 1;
+        allocate();
+
+        for(auto r = m_top; r <= m_bottom; ++r)
+        {
+            auto from = old.data() + (r + 1) * old_words;
+            std::copy(from, from + old_words, row(m_cells, r + row_offset) + word_offset);
+        }
+
+        m_top += row_offset;
+        m_bottom += row_offset;
+        m_first_word += word_offset;
+        m_last_word += word_offset;
+    }
+
+    std::size_t m_rows = 0;
+    std::size_t m_words = 0;
+    cells_t m_cells;
+    cells_t m_next;
+    std::array<cells_t, 4> m_proposals;     // North, south, west, east
+    std::size_t m_first = 0;
+
+    // The rows and words any elf has reached
+    std::size_t m_top = 0;
+    std::size_t m_bottom = 0;
+    std::size_t m_first_word = 0;
+    std::size_t m_last_word = 0;
+
+    std::vector<band_t> m_bands;
+    std::barrier<> m_sync;
+    bool m_stop = false;
+    std::vector<std::jthread> m_workers;
+};
+
+// Packed positions, open addressing with a slot per position. Rather than being cleared, the
+// table moves on to a new generation and slots from older ones count as empty, so the same
+// table is reused every round.
+class position_index_t
+{
+public:
+    explicit position_index_t(std::size_t count)
+    : m_slots(std::bit_ceil(count * 2)),
+      m_shift(32 - std::countr_zero(m_slots.size()))
+    {
+    }
+
+    void clear()
+    {
+        if(++m_generation == 0)
+        {
+            std::fill(m_slots.begin(), m_slots.end(), slot_t{});
+            m_generation = 1;
+        }
+    }
+
+    // How many times the position has been added since the table was last cleared
+    auto count(uint32_t position) const -> uint32_t
+    {
+        auto & slot = m_slots[find(position)];
+        return slot.generation == m_generation ? slot.count : 0;
+    }
+
+    auto add(uint32_t position) -> uint32_t
+    {
+        auto & slot = m_slots[find(position)];
+        if(slot.generation != m_generation)
+            slot = slot_t{position, m_generation, 0};
+        return ++slot.count;
+    }
+
+private:
+    struct slot_t
+    {
+        uint32_t position = 0;
+        uint32_t generation = 0;
+        uint32_t count = 0;
+    };
+
+    // The slot holding the position, or the empty one where it would go
+    auto find(uint32_t position) const -> std::size_t
+    {
+        auto mask = m_slots.size() - 1;
+        auto index = static_cast<std::size_t>((position * 0x9e3779b1u) >> m_shift);
+
+        while(m_slots[index].generation == m_generation && m_slots[index].position != position)
+            index = (index + 1) & mask;
+
+        return index;
+    }
+
+    std::vector<slot_t> m_slots;
+    int m_shift;
+    uint32_t m_generation = 1;
+};
+
+// The elves as a flat array of positions, each packed into 32 bits as row << 16 | column, with
+// an offset so that moving a step in any direction is just adding a constant. The arrays and
+// indexes are all sized up front and swapped or reused each round, so rounds don't allocate.
+class packed_elves_t
+{
+public:
+    explicit packed_elves_t(elves_t const & elves)
+    : m_occupied(elves.size()), m_proposed(elves.size())
+    {
+        m_elves.reserve(elves.size());
+        std::for_each(elves.begin(), elves.end(), [this](auto const & elf)
+        {
+            m_elves.push_back(static_cast<uint32_t>(elf.first + offset) * row_step + static_cast<uint32_t>(elf.second + offset));
+        });
+
+        m_next.resize(m_elves.size());
+        m_targets.resize(m_elves.size());
+    }
+
+    // Run a round, returning how many elves moved
+    auto round() -> std::size_t
+    {
+        m_occupied.clear();
+        for(auto elf : m_elves)
+            m_occupied.add(elf);
+
+        // Neighbours in the order NW, N, NE, W, E, SW, S, SE
+        constexpr std::array<uint32_t, 8> around{0 - row_step - 1, 0 - row_step, 0 - row_step + 1, 0u - 1,
+                                                 1, row_step - 1, row_step, row_step + 1};
+
+        // For north, south, west and east, the neighbours which must be clear and the step taken
+        constexpr std::array<uint8_t, 4> sides{0x07, 0xe0, 0x29, 0x94};
+        constexpr std::array<uint32_t, 4> steps{0 - row_step, row_step, 0u - 1, 1};
+
+        m_proposed.clear();
+        for(std::size_t i = 0; i < m_elves.size(); ++i)
+        {
+            auto elf = m_elves[i];
+            uint8_t neighbours = 0;
+
+            for(std::size_t n = 0; n < around.size(); ++n)
+            {
+                if(m_occupied.count(elf + around[n]))
+                    neighbours |= static_cast<uint8_t>(1 << n);
+            }
+
+            m_targets[i] = elf;
+            for(std::size_t d = 0; neighbours && d < 4; ++d)
+            {
+                auto dir = (m_first + d) % 4;
+                if(!(neighbours & sides[dir]))
+                {
+                    m_targets[i] = elf + steps[dir];
+                    m_proposed.add(m_targets[i]);
+                    break;
+                }
+            }
+        }
+
+        std::size_t moved = 0;
+        for(std::size_t i = 0; i < m_elves.size(); ++i)
+        {
+            auto move = m_targets[i] != m_elves[i] && m_proposed.count(m_targets[i]) == 1;
+            m_next[i] = move ? m_targets[i] : m_elves[i];
+            moved += move ? 1 : 0;
+        }
+
+        std::swap(m_elves, m_next);
+        m_first = (m_first + 1) % 4;
+
+        return moved;
+    }
+
+    // Empty cells in the smallest rectangle holding all the elves
+    auto empty_ground() const -> std::size_t
+    {
+        auto [rows, cols] = std::accumulate(m_elves.begin(), m_elves.end(),
+            std::make_pair(std::make_pair(~0u, 0u), std::make_pair(~0u, 0u)), [](auto range, uint32_t elf)
+        {
+            auto row = elf / row_step, col = elf % row_step;
+            return std::make_pair(std::make_pair(std::min(range.first.first, row), std::max(range.first.second, row)),
+                                  std::make_pair(std::min(range.second.first, col), std::max(range.second.second, col)));
+        });
+
+        return static_cast<std::size_t>(rows.second + 1 - rows.first) * (cols.second + 1 - cols.first) - m_elves.size();
+    }
+
+private:
+    static constexpr uint32_t row_step = 0x10000;
+
+    // Keeps rows and columns well clear of wrapping however far the elves spread
+    static constexpr int64_t offset = 0x8000;
+
+    std::vector<uint32_t> m_elves;
+    std::vector<uint32_t> m_next;
+    std::vector<uint32_t> m_targets;
+    position_index_t m_occupied;
+    position_index_t m_proposed;
+    std::size_t m_first = 0;
+};
+
+template<typename engine_t>
+auto part1(engine_t & grid) -> std::size_t
+{
+    for(int round = 0; round < 10; ++round)
+        grid.round();
+
+    return grid.empty_ground();
+}
+
+// With stats, reports how many allocations the first round made, and the most any later one did
+template<typename engine_t>
+auto part2(engine_t & grid, bool stats = false) -> std::size_t
+{
+    std::size_t round = 1, first = 0, most = 0;
+
+    while(true)
+    {
+        auto before = allocations;
+        auto moved = grid.round();
+
+        (round == 1 ? first : most) = std::max(round == 1 ? first : most, allocations - before);
+        if(!moved)
+            break;
+        ++round;
+    }
+
+    if(stats)
+        std::cout << "Allocations: " << first << " in the first round, at most " << most << " in the other " << round - 1 << std::endl;
+
+    return round;
 }
-int main()
+
+// A square field of about a million elves, each cell filled at random with even odds
+auto synthetic_field() -> elves_t
 {
+    elves_t ret;
+    std::mt19937 gen(23);
+
+    for(int64_t row = 0; row < 1414; ++row)
+    {
+        for(int64_t col = 0; col < 1414; ++col)
+            if(gen() & 1)
+                ret.insert(elf_t{row, col});
+    }
+    return ret;
+}
+
+// Rounds per second on the synthetic field with more and more threads, checking every thread
+// count moves the same elves
+void bench(int rounds)
+{
+    auto elves = synthetic_field();
+    std::vector<std::size_t> expected;
+    std::size_t expected_ground = 0;
+
+    std::cout << elves.size() << " elves, " << rounds << " rounds" << std::endl;
+
+    for(std::size_t threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2)
+    {
+        bitgrid_t grid{elves, threads};
+        std::vector<std::size_t> moved;
+
+        auto start = std::chrono::steady_clock::now();
+        for(int round = 0; round < rounds; ++round)
+            moved.push_back(grid.round());
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+        if(expected.empty())
+        {
+            expected = moved;
+            expected_ground = grid.empty_ground();
+        }
+
+        std::cout << threads << " threads: " << rounds / took.count() << " rounds/s"
+                  << (moved == expected && grid.empty_ground() == expected_ground ? "" : ", differs from 1 thread") << std::endl;
+    }
+}
+
+// Usage: main [grid|packed|set] [threads] [stats], to run on the bitgrid (with some threads),
+// packed positions or the original set of elves, optionally reporting allocations per round.
+// Or main bench [rounds] on a synthetic field of a million elves.
+int main(int argc, char * argv[])
+{
+    auto mode = std::string{argc > 1 ? argv[1] : "grid"};
+
+    if(mode == "bench")
+    {
+        bench(argc > 2 ? std::stoi(argv[2]) : 100);
+        return 0;
+    }
+
     auto elves = parse();
-    std::cout << part1(elves) << std::endl;
-    std::cout << part2(elves) << std::endl;
+    auto threads = std::size_t{1};
+    auto stats = false;
+
+    for(int arg = 2; arg < argc; ++arg)
+    {
+        if(std::string{argv[arg]} == "stats")
+            stats = true;
+        else
+            threads = std::stoul(argv[arg]);
+    }
+
+    if(mode == "set")
+    {
+        std::cout << part1(elves) << std::endl;
+        std::cout << part2(elves, stats) << std::endl;
+        return 0;
+    }
+
+    if(mode == "packed")
+    {
+        packed_elves_t packed{elves}, packed2{elves};
+        std::cout << part1(packed) << std::endl;
+        std::cout << part2(packed2, stats) << std::endl;
+        return 0;
+    }
+
+    bitgrid_t grid{elves, threads}, grid2{elves, threads};
+    std::cout << part1(grid) << std::endl;
+    std::cout << part2(grid2, stats) << std::endl;
     return 0;
-}
\ No newline at end of file
+}